@@ -1,3 +1,4 @@
+#include <cmath>
 #include <string>
 #include <vector>
 #include "realms.h"
@@ -8,7 +9,71 @@ extern std::vector<Species> sapientSpecies;
 
 std::string makeNameCore(int depth);
 
-std::vector<std::string> usedNames;
+// Open-addressed (linear probing) set of every name the generator has handed
+// out so far. Lookups hash straight from the build buffer, so a rejected
+// candidate never allocates.
+class NameSet {
+public:
+    NameSet() : count(0) { slots.resize(512); used.resize(512, 0); }
+
+    bool contains(const char *text, unsigned length) const {
+        unsigned mask = slots.size() - 1;
+        for (unsigned i = hash(text, length) & mask; used[i]; i = (i + 1) & mask) {
+            if (slots[i].size() == length && slots[i].compare(0, length, text, length) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void reserve(unsigned extra) {
+        while ((count + extra) * 2 > slots.size()) grow();
+    }
+
+    // returns false if the name was already present
+    bool insert(const char *text, unsigned length) {
+        if (contains(text, length)) return false;
+        if ((count + 1) * 2 > slots.size()) grow();
+        place(std::string(text, length));
+        ++count;
+        return true;
+    }
+
+private:
+    static unsigned hash(const char *text, unsigned length) {
+        // FNV-1a
+        unsigned h = 2166136261u;
+        for (unsigned i = 0; i < length; ++i) {
+            h ^= static_cast<unsigned char>(text[i]);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    void place(std::string &&name) {
+        unsigned mask = slots.size() - 1;
+        unsigned i = hash(name.data(), name.size()) & mask;
+        while (used[i]) i = (i + 1) & mask;
+        slots[i] = std::move(name);
+        used[i] = 1;
+    }
+
+    void grow() {
+        std::vector<std::string> oldSlots(slots.size() * 2);
+        std::vector<unsigned char> oldUsed(used.size() * 2, 0);
+        oldSlots.swap(slots);
+        oldUsed.swap(used);
+        for (unsigned i = 0; i < oldSlots.size(); ++i) {
+            if (oldUsed[i]) place(std::move(oldSlots[i]));
+        }
+    }
+
+    std::vector<std::string> slots;
+    std::vector<unsigned char> used;
+    unsigned count;
+};
+
+NameSet usedNames;
 
 struct Colour { int r; int g; int b; };
 std::vector<Colour> colourList = {
@@ -40,6 +105,34 @@ std::vector<Colour> colourList = {
     {255,80,5}
 };
 
+// Colours past the end of the hand-picked list are spaced around the hue
+// circle by the golden ratio, which keeps consecutive colours far apart.
+Colour makeColour(unsigned index) {
+    if (index < colourList.size()) return colourList[index];
+
+    const double GOLDEN_RATIO_CONJUGATE = 0.618033988749895;
+    double hue = fmod(0.1 + index * GOLDEN_RATIO_CONJUGATE, 1.0) * 6.0;
+    // alternate saturation and value bands so near hues still differ
+    double saturation = (index % 3 == 0) ? 0.45 : 0.75;
+    double value = (index % 2 == 0) ? 0.95 : 0.7;
+
+    int sector = static_cast<int>(hue);
+    double f = hue - sector;
+    double p = value * (1 - saturation);
+    double q = value * (1 - saturation * f);
+    double t = value * (1 - saturation * (1 - f));
+    double r, g, b;
+    switch (sector) {
+        case 0:  r = value; g = t; b = p; break;
+        case 1:  r = q; g = value; b = p; break;
+        case 2:  r = p; g = value; b = t; break;
+        case 3:  r = p; g = q; b = value; break;
+        case 4:  r = t; g = p; b = value; break;
+        default: r = value; g = p; b = q; break;
+    }
+    return Colour{ static_cast<int>(r * 255), static_cast<int>(g * 255), static_cast<int>(b * 255) };
+}
+
 std::vector<int> wordCount{
     1, 1, 1, 2, 2, 2
 };
@@ -48,47 +141,59 @@ std::vector<std::string> syllableForms{
     "CV", "CV", "CV", "CVC", "CVC"
 };
 
-std::vector<std::string> C{
-    "b", "d", "f", "g", "j",   "k", "l", "m", "n",
-    "p", "r", "s", "t", "v",   "z"
+std::vector<char> C{
+    'b', 'd', 'f', 'g', 'j',   'k', 'l', 'm', 'n',
+    'p', 'r', 's', 't', 'v',   'z'
 };
 
-std::vector<std::string> V{
-    "a", "e", "i", "o", "u"
+std::vector<char> V{
+    'a', 'e', 'i', 'o', 'u'
 };
 
 std::string makeName() {
     const int MAX_ITERATIONS = 100;
     const int MIN_SYLLABLES = 2;
     const int MAX_SYLLABLES = 5;
+    // two words of at most four CVC syllables each, plus the separator
+    const int MAX_LENGTH = 2 * (MAX_SYLLABLES - 1) * 3 + 1;
 
+    char name[MAX_LENGTH + 1];
     int iterations = 0;
     while (iterations < MAX_ITERATIONS) {
         int words = rngVector(wordCount);
-        std::string name;
+        int length = 0;
 
         for (int i = 0; i < words; ++i) {
-            if (i != 0) name += " ";
+            if (i != 0) name[length++] = ' ';
             int sylCount = MIN_SYLLABLES + rngNext(MAX_SYLLABLES - MIN_SYLLABLES);
             for (int j = 0; j < sylCount; ++j) {
-                std::string form = rngVector(syllableForms);
+                const std::string &form = rngVector(syllableForms);
                 for (char c : form) {
-                    if (c == 'C') name += rngVector(C);
-                    if (c == 'V') name += rngVector(V);
+                    if (c == 'C') name[length++] = rngVector(C);
+                    if (c == 'V') name[length++] = rngVector(V);
                 }
             }
         }
 
         name[0] = name[0] - ('a' - 'A');
-        if (!contains(usedNames, name)) {
-            usedNames.push_back(name);
-            return name;
+        if (usedNames.insert(name, length)) {
+            return std::string(name, length);
         } else ++iterations;
     }
 
     return "(namegen exceeded max iterations)";
 }
 
+std::vector<std::string> makeNames(unsigned count) {
+    std::vector<std::string> names;
+    names.reserve(count);
+    usedNames.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        names.push_back(makeName());
+    }
+    return names;
+}
+
 
 
 std::vector<Stance> stanceList{
@@ -102,9 +207,10 @@ std::vector<Wings> wingList{
     Wings::Arm, Wings::Arm, Wings::Back,
 };
 
-Species* makeSpecies() {
+Species* makeSpecies(const std::vector<std::string> &speciesNames) {
     static unsigned identCounter = 0;
     static unsigned nextPremade = 0;
+    static unsigned nextName = 0;
     static unsigned nextColour = 0;
     Species *s = new Species;
     s->ident = identCounter;
@@ -118,18 +224,21 @@ Species* makeSpecies() {
         s->wings = src.wings;
         ++nextPremade;
     } else {
-        s->name = makeName();
+        if (nextName < speciesNames.size()) {
+            s->name = speciesNames[nextName];
+            ++nextName;
+        } else s->name = makeName();
         s->abbrev = s->name.substr(0, 2);
         s->height = 50 + rngNext(150);
         s->stance = rngVector(stanceList);
         if (s->stance == Stance::Taur)  s->wings = Wings::None;
         else                            s->wings = rngVector(wingList);
     }
-    s->r = colourList[nextColour].r;
-    s->g = colourList[nextColour].g;
-    s->b = colourList[nextColour].b;
+    Colour colour = makeColour(nextColour);
+    s->r = colour.r;
+    s->g = colour.g;
+    s->b = colour.b;
     ++nextColour;
-    if (nextColour >= colourList.size()) nextColour = 0;
     return s;
 }
 
@@ -145,10 +254,10 @@ Faction* makeFaction(const std::vector<std::string> &factionNames) {
             f->name = factionNames[namePosition];
         } else f->name = makeName();
     }
-    int colorNum = f->ident;
-    f->r = colourList[colorNum].r;
-    f->g = colourList[colorNum].g;
-    f->b = colourList[colorNum].b;
+    Colour colour = makeColour(f->ident);
+    f->r = colour.r;
+    f->g = colour.g;
+    f->b = colour.b;
     f->home = -1;
     return f;
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "realms.h"
+
+unsigned long long profileCounters[static_cast<int>(ProfileCounter::Count)] = { 0 };
+
+static const char *counterNames[] = {
+    "nearest_queries", "link_rejections", "intersect_tests", "retries"
+};
+static const char *counterHeadings[] = {
+    "NEAREST", "REJECTED", "X-TESTS", "RETRIES"
+};
+
+struct StageRecord {
+    std::string name;
+    double seconds;
+    long peakMemoryKB;
+    unsigned long long counters[static_cast<int>(ProfileCounter::Count)];
+};
+
+static std::vector<StageRecord> stages;
+
+typedef std::chrono::steady_clock Clock;
+
+long peakMemoryKB() {
+#ifdef _WIN32
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+
+StageTimer::StageTimer(const std::string &name) {
+    start(name);
+}
+
+StageTimer::~StageTimer() {
+    finish();
+}
+
+void StageTimer::next(const std::string &name) {
+    finish();
+    start(name);
+}
+
+void StageTimer::start(const std::string &name) {
+    stageName = name;
+    running = true;
+    for (int i = 0; i < static_cast<int>(ProfileCounter::Count); ++i) {
+        startCounters[i] = profileCounters[i];
+    }
+    startTime = std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+void StageTimer::finish() {
+    if (!running) return;
+    running = false;
+    double now = std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+
+    StageRecord record;
+    record.name = stageName;
+    record.seconds = now - startTime;
+    record.peakMemoryKB = peakMemoryKB();
+    for (int i = 0; i < static_cast<int>(ProfileCounter::Count); ++i) {
+        record.counters[i] = profileCounters[i] - startCounters[i];
+    }
+    stages.push_back(record);
+}
+
+
+void profileReport(std::ostream &out) {
+    double total = 0;
+    for (const StageRecord &s : stages) total += s.seconds;
+
+    out << std::left << std::setw(24) << "STAGE" << std::right;
+    out << std::setw(10) << "SECONDS" << std::setw(6) << "%";
+    for (const char *heading : counterHeadings) out << std::setw(12) << heading;
+    out << std::setw(12) << "PEAK KB" << '\n';
+
+    for (const StageRecord &s : stages) {
+        out << std::left << std::setw(24) << s.name << std::right;
+        out << std::setw(10) << std::fixed << std::setprecision(3) << s.seconds;
+        out << std::setw(6) << std::setprecision(1) << (total > 0 ? s.seconds * 100 / total : 0.0);
+        for (unsigned long long count : s.counters) out << std::setw(12) << count;
+        out << std::setw(12) << s.peakMemoryKB << '\n';
+    }
+
+    out << std::left << std::setw(24) << "total" << std::right;
+    out << std::setw(10) << std::setprecision(3) << total << std::setw(6) << "";
+    for (unsigned long long count : profileCounters) out << std::setw(12) << count;
+    out << std::setw(12) << peakMemoryKB() << '\n';
+    out.unsetf(std::ios::fixed);
+}
+
+bool profileWriteJSON(const std::string &filename, const std::string &version, unsigned realmCount) {
+    std::ofstream json(filename);
+    if (!json) return false;
+
+    double total = 0;
+    for (const StageRecord &s : stages) total += s.seconds;
+
+    json << std::setprecision(6) << std::fixed;
+    json << "{\n";
+    json << "\t\"generator\": \"bigbang\",\n";
+    json << "\t\"version\": \"" << version << "\",\n";
+    json << "\t\"realms\": " << realmCount << ",\n";
+    json << "\t\"total_seconds\": " << total << ",\n";
+    json << "\t\"peak_rss_kb\": " << peakMemoryKB() << ",\n";
+    json << "\t\"counters\": {";
+    for (int i = 0; i < static_cast<int>(ProfileCounter::Count); ++i) {
+        if (i > 0) json << ',';
+        json << "\n\t\t\"" << counterNames[i] << "\": " << profileCounters[i];
+    }
+    json << "\n\t},\n";
+
+    json << "\t\"stages\": [";
+    for (unsigned i = 0; i < stages.size(); ++i) {
+        const StageRecord &s = stages[i];
+        if (i > 0) json << ',';
+        json << "\n\t\t{\n";
+        json << "\t\t\t\"name\": \"" << s.name << "\",\n";
+        json << "\t\t\t\"seconds\": " << s.seconds << ",\n";
+        json << "\t\t\t\"peak_rss_kb\": " << s.peakMemoryKB << ",\n";
+        json << "\t\t\t\"counters\": {";
+        for (int j = 0; j < static_cast<int>(ProfileCounter::Count); ++j) {
+            if (j > 0) json << ',';
+            json << " \"" << counterNames[j] << "\": " << s.counters[j];
+        }
+        json << " }\n\t\t}";
+    }
+    json << "\n\t]\n}\n";
+    return true;
+}
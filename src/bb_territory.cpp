@@ -0,0 +1,116 @@
+#include <iostream>
+#include <vector>
+#include "realms.h"
+
+// Faction placement and territory growth. Both work on World::graph, so the
+// graph must be rebuilt once the realm links are final.
+
+const int UNREACHED = 0x7FFFFFFF;
+
+// Lowers the distances in dist to account for a new source realm, only
+// visiting realms that end up closer to the new source than to any old one.
+static void relaxDistances(const RealmGraph &graph, std::vector<int> &dist, unsigned source) {
+    std::vector<unsigned> frontier{source};
+    std::vector<unsigned> next;
+    dist[source] = 0;
+    int depth = 0;
+    while (!frontier.empty()) {
+        ++depth;
+        next.clear();
+        for (unsigned c : frontier) {
+            for (unsigned i = graph.firstLink[c]; i < graph.firstLink[c + 1]; ++i) {
+                unsigned t = graph.linkTarget[i];
+                if (dist[t] <= depth) continue;
+                dist[t] = depth;
+                next.push_back(t);
+            }
+        }
+        frontier.swap(next);
+    }
+}
+
+// Places faction homes by farthest-point sampling: the first home is random
+// and each later home goes on the realm farthest (in transits) from every
+// existing home, chosen at random among ties. Homes closer than minHops to
+// another home are refused. Returns the number of factions placed.
+int placeFactionHomes(World &world, int minHops) {
+    const RealmGraph &graph = world.graph;
+    std::vector<int> dist(graph.size(), UNREACHED);
+    std::vector<unsigned> candidates;
+    int placed = 0;
+
+    for (unsigned f = 1; f < world.factions.size(); ++f) {
+        int home = -1;
+        if (placed == 0) {
+            home = rngNext(graph.size());
+        } else {
+            int farthest = -1;
+            candidates.clear();
+            for (unsigned i = 0; i < dist.size(); ++i) {
+                if (dist[i] > farthest) {
+                    farthest = dist[i];
+                    candidates.clear();
+                }
+                if (dist[i] == farthest) candidates.push_back(i);
+            }
+            if (farthest >= minHops) home = rngVector(candidates);
+        }
+
+        if (home < 0) {
+            std::cerr << "\tFailed to place faction " << f << ".\n";
+            continue;
+        }
+
+        Realm *r = world.realms[home];
+        r->faction = f;
+        r->factionHome = true;
+        world.factions[f]->home = r->ident;
+        relaxDistances(graph, dist, home);
+        ++placed;
+    }
+    return placed;
+}
+
+// Grows every faction outward from its home one transit at a time. A realm
+// reached by a single faction in a round joins it; one reached by several
+// becomes contested (faction 0) and stops spreading. Anything never reached
+// is left independent.
+void growTerritories(World &world) {
+    const RealmGraph &graph = world.graph;
+    std::vector<unsigned> frontier;
+    std::vector<unsigned> next;
+    for (unsigned i = 0; i < world.realms.size(); ++i) {
+        // work1 holds the faction claiming a realm during the current round
+        world.realms[i]->work1 = -1;
+        if (world.realms[i]->faction > 0) frontier.push_back(i);
+    }
+
+    while (!frontier.empty()) {
+        next.clear();
+        for (unsigned c : frontier) {
+            int faction = world.realms[c]->faction;
+            for (unsigned i = graph.firstLink[c]; i < graph.firstLink[c + 1]; ++i) {
+                Realm *t = world.realms[graph.linkTarget[i]];
+                if (t->work1 < 0) {
+                    if (t->faction >= 0) continue;
+                    t->work1 = faction;
+                    next.push_back(graph.linkTarget[i]);
+                } else if (t->work1 != faction) {
+                    t->work1 = 0;
+                }
+            }
+        }
+
+        frontier.clear();
+        for (unsigned c : next) {
+            Realm *r = world.realms[c];
+            r->faction = r->work1;
+            r->work1 = -1;
+            if (r->faction > 0) frontier.push_back(c);
+        }
+    }
+
+    for (Realm *r : world.realms) {
+        if (r->faction < 0) r->faction = 0;
+    }
+}
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "realms.h"
+
+// Benchmark driver: builds synthetic universes of fixed seed and times the
+// loader, the World queries, every realms command and every exporter.
+// Exporters write into the current directory, so run it from a scratch
+// directory (the makefile's bench target does this).
+
+const int BENCH_SEED = 1234;
+const int TARGET_REPS = 7;
+const double REP_BUDGET_SECONDS = 5.0;
+const double SKIP_ESTIMATE_SECONDS = 60.0;
+
+
+// Every allocation made while a benchmark runs is counted here. Some
+// commands start worker threads, so the counters are atomic; relaxed
+// ordering is enough since they are only read once the workers are done.
+static std::atomic<unsigned long long> allocCount(0);
+static std::atomic<unsigned long long> allocBytes(0);
+
+void* operator new(std::size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+
+// Universe laid out on a jittered grid: every realm links to its neighbour
+// in the same row and about half link to the realm above, so the whole
+// world is one connected group. No step is worse than O(N log N).
+void buildSyntheticWorld(World &world, unsigned count) {
+    rngInit(BENCH_SEED);
+    const int spacing = 3;
+    const unsigned columns = ceil(sqrt(count * 1.5));
+    const unsigned factionCount = std::max(20u, count / 25);
+    const unsigned speciesCount = std::max(30u, count / 16);
+
+    for (unsigned i = 0; i < factionCount; ++i) {
+        Faction *f = new Faction;
+        f->ident = i;
+        f->name = i == 0 ? "Independant" : "Faction " + std::to_string(i);
+        f->r = rngNext(256);
+        f->g = rngNext(256);
+        f->b = rngNext(256);
+        f->home = -1;
+        world.factions.push_back(f);
+    }
+    for (unsigned i = 0; i < speciesCount; ++i) {
+        Species *s = new Species;
+        s->ident = i;
+        s->name = "Species " + std::to_string(i);
+        s->abbrev = "S" + std::to_string(i % 10);
+        s->stance = static_cast<Stance>(rngNext(static_cast<int>(Stance::Count)));
+        s->wings = static_cast<Wings>(rngNext(static_cast<int>(Wings::Count)));
+        s->height = 50 + rngNext(150);
+        s->r = rngNext(256);
+        s->g = rngNext(256);
+        s->b = rngNext(256);
+        world.species.push_back(s);
+    }
+
+    world.maxX = 0;
+    world.maxY = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        Realm *r = new Realm;
+        unsigned column = i % columns;
+        unsigned row = i / columns;
+        r->ident = i + 1;
+        r->name = "Realm " + std::to_string(r->ident);
+        r->x = column * spacing + rngNext(spacing - 1);
+        r->y = row * spacing + rngNext(spacing - 1);
+        r->diameter = 412 + rngNext(208);
+        r->populationDensity = 15 + rngNext(70);
+        r->biome = static_cast<Biome>(rngNext(static_cast<int>(Biome::BiomeCount)));
+        r->primarySpecies = rngNext(speciesCount);
+        r->faction = 1 + static_cast<unsigned long long>(i) * (factionCount - 1) / count;
+        r->factionHome = false;
+        r->work1 = r->work2 = 0;
+        if (world.factions[r->faction]->home < 0) {
+            world.factions[r->faction]->home = r->ident;
+            r->factionHome = true;
+        }
+        world.maxX = std::max(world.maxX, r->x);
+        world.maxY = std::max(world.maxY, r->y);
+        world.realms.push_back(r);
+
+        if (column > 0) r->addLink(world.realms[i - 1]);
+        if (row > 0 && (column == 0 || rngNext(2) == 0)) r->addLink(world.realms[i - columns]);
+    }
+    for (Realm *r : world.realms) {
+        for (Link &l : r->links) {
+            l.distance = 25 + rngNext(50);
+            l.bearing = rngNext(360);
+        }
+    }
+    world.rebuildGraph();
+    world.rebuildPositions();
+    world.updateMetrics();
+    world.markChanged();
+}
+
+void freeWorld(World &world) {
+    for (Realm *r : world.realms) delete r;
+    for (Faction *f : world.factions) delete f;
+    for (Species *s : world.species) delete s;
+    world.realms.clear();
+    world.factions.clear();
+    world.species.clear();
+}
+
+
+struct BenchCase {
+    std::string name;
+    std::function<void()> run;
+};
+
+struct BenchResult {
+    unsigned realms;
+    double seconds;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double percentile(std::vector<double> times, double fraction) {
+    std::sort(times.begin(), times.end());
+    unsigned index = ceil(fraction * times.size());
+    if (index > 0) --index;
+    return times[index];
+}
+
+// Guesses how long a case will take at the next size from its growth rate
+// over the previous two sizes, assuming quadratic growth until two are known.
+double estimateSeconds(const std::vector<BenchResult> &history, unsigned realms) {
+    if (history.empty()) return 0;
+    const BenchResult &last = history.back();
+    double exponent = 2;
+    if (history.size() > 1) {
+        const BenchResult &prev = history[history.size() - 2];
+        if (prev.seconds > 0 && last.seconds > 0) {
+            exponent = log(last.seconds / prev.seconds) / log(1.0 * last.realms / prev.realms);
+            exponent = std::min(3.0, std::max(1.0, exponent));
+        }
+    }
+    return last.seconds * pow(1.0 * realms / last.realms, exponent);
+}
+
+// "dist 1 500" becomes "cmd: dist N N" so results line up across sizes
+std::string commandLabel(const std::string &command) {
+    std::string label = "cmd:";
+    for (const std::string &part : explodeOnWhitespace(command)) {
+        label += ' ';
+        label += strToInt(part) >= 0 ? "N" : part;
+    }
+    return label;
+}
+
+std::vector<unsigned> parseSizes(const std::string &text) {
+    std::vector<unsigned> sizes;
+    for (const std::string &part : explode(text, ',')) {
+        int size = strToInt(part);
+        if (size < 1) return std::vector<unsigned>();
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<unsigned> sizes{ 1000, 10000, 100000, 1000000 };
+    std::string csvFile = "bench.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+            if (sizes.empty()) {
+                std::cerr << "Sizes must be a comma separated list of positive integers.\n";
+                return 1;
+            }
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csvFile = argv[++i];
+        } else {
+            std::cerr << "USAGE: bench [--sizes 1000,10000,...] [--csv file]\n";
+            return 1;
+        }
+    }
+
+    std::ofstream csv(csvFile);
+    if (!csv) {
+        std::cerr << "Failed to open " << csvFile << ".\n";
+        return 1;
+    }
+    csv << "realms,benchmark,status,reps,median_ms,p95_ms,allocs,alloc_kb\n";
+    csv << std::fixed << std::setprecision(3);
+
+    std::map<std::string, std::vector<BenchResult> > history;
+    std::ostringstream discard;
+    std::streambuf *realCout = std::cout.rdbuf();
+
+    for (unsigned size : sizes) {
+        World world;
+        buildSyntheticWorld(world, size);
+        std::cerr << "Universe of " << size << " realms built.\n";
+        world.writeToFile("bench_realms.txt");
+
+        // fixed query targets, far enough apart to make paths non-trivial
+        const Realm *first = world.realms.front();
+        const Realm *last = world.realms.back();
+        const Realm *middle = world.realms[world.realms.size() / 2];
+        const std::string from = std::to_string(first->ident);
+        const std::string to = std::to_string(last->ident);
+        const std::string mid = std::to_string(middle->ident);
+        const std::string midX = std::to_string(middle->x);
+        const std::string midY = std::to_string(middle->y);
+
+        std::vector<BenchCase> cases{
+            { "readFromFile",   [&]() { World loaded; loaded.readFromFile("bench_realms.txt"); freeWorld(loaded); } },
+            { "writeToFile",    [&]() { world.writeToFile("bench_realms.txt"); } },
+            { "getNearest",     [&]() { world.getNearest(middle->x, middle->y, middle->ident); } },
+            { "KDTree::nearest", [&]() { std::vector<KDTree::Hit> hits; world.positions.nearest(middle->x, middle->y, 10, hits); } },
+            { "setDistances",   [&]() { world.setDistances(first->ident); } },
+            { "findPath",       [&]() { world.findPath(first->ident, last->ident); } },
+        };
+        std::vector<std::string> commands{
+            "checknames", "dist " + from + " " + to, "path " + from + " " + to,
+            "near " + mid + " 3", "nearxy " + midX + " " + midY + " 10",
+            "random 100", "realm " + mid, "species 0",
+            "list realms", "list realms name", "list realms species", "list realms faction",
+            "list factions", "list factions name", "list species", "list species name",
+            "stats realm", "stats species", "stats faction",
+            "dot", "json", "sql", "svg",
+        };
+        for (const std::string &command : commands) {
+            cases.push_back(BenchCase{ commandLabel(command),
+                                       [&world, &discard, command]() { processCommand(world, command, discard); } });
+        }
+
+        for (const BenchCase &c : cases) {
+            std::vector<BenchResult> &past = history[c.name];
+            double estimate = estimateSeconds(past, size);
+            if (estimate > SKIP_ESTIMATE_SECONDS) {
+                std::cerr << "  " << std::left << std::setw(28) << c.name << std::right;
+                std::cerr << "skipped (estimated " << static_cast<int>(estimate) << " s)\n";
+                csv << size << ",\"" << c.name << "\",skipped,0,,,,\n";
+                continue;
+            }
+
+            std::vector<double> times;
+            unsigned long long allocs = 0, bytes = 0;
+            double spent = 0;
+            while (static_cast<int>(times.size()) < TARGET_REPS && (times.empty() || spent < REP_BUDGET_SECONDS)) {
+                std::cout.rdbuf(discard.rdbuf());
+                unsigned long long startAllocs = allocCount, startBytes = allocBytes;
+                Clock::time_point start = Clock::now();
+                c.run();
+                double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                if (times.empty()) {
+                    allocs = allocCount - startAllocs;
+                    bytes = allocBytes - startBytes;
+                }
+                std::cout.rdbuf(realCout);
+                discard.str("");
+                times.push_back(seconds);
+                spent += seconds;
+            }
+
+            double median = percentile(times, 0.5);
+            double p95 = percentile(times, 0.95);
+            past.push_back(BenchResult{ size, median });
+            std::cerr << "  " << std::left << std::setw(28) << c.name << std::right;
+            std::cerr << std::setw(12) << std::fixed << std::setprecision(3) << median * 1000 << " ms";
+            std::cerr << std::setw(12) << p95 * 1000 << " ms p95";
+            std::cerr << std::setw(12) << allocs << " allocs\n";
+            csv << size << ",\"" << c.name << "\",ok," << times.size() << ',';
+            csv << median * 1000 << ',' << p95 * 1000 << ',' << allocs << ',' << bytes / 1024.0 << '\n';
+        }
+        csv.flush();
+        freeWorld(world);
+    }
+
+    std::cerr << "Wrote results to " << csvFile << ".\n";
+    return 0;
+}
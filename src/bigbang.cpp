@@ -12,6 +12,9 @@
 
 #include "realms.h"
 
+// default data from data.cpp
+extern std::vector<Species> sapientSpecies;
+
 std::vector<std::string> realmNames;
 std::vector<std::string> factionNames;
 
@@ -22,8 +25,157 @@ const int MAX_WIDTH = 200;
 const int MAX_HEIGHT = MAX_WIDTH * 2 / 3;
 const int MAX_ITERATIONS = 100;
 const int RNG_SEED = 234;
+const char *VERSION = "Alpha";
 const int MAX_LINK_DIST = 10;
+const int MIN_REALM_DIST = 3;
 const int SPECIES_MIN_DIST = 3;
+const int LEAF_MIN_HOPS = 6;
+
+// map area per realm the default extents give a 500 realm universe
+const double DEFAULT_REALM_AREA = MAX_WIDTH * MAX_HEIGHT / 500.0;
+const int REALMS_PER_FACTION = 25;
+const int REALMS_PER_SPECIES = 16;
+
+// Map extents and densities used for one run. The defaults are the classic
+// fixed-size universe; --large scales them to the realm count and --config
+// overrides individual values from a file.
+struct GenProfile {
+    int width, height;
+    int factions, species;
+    int maxLinkDist;
+    int minDist;
+    double realmArea;
+    // keys set by --config, which scaling leaves alone
+    std::set<std::string> configured;
+};
+
+GenProfile defaultProfile() {
+    return GenProfile{ MAX_WIDTH, MAX_HEIGHT, MAX_FACTIONS, MAX_SPECIES,
+                       MAX_LINK_DIST, MIN_REALM_DIST, DEFAULT_REALM_AREA, { } };
+}
+
+// Grows the map so each realm gets about realmArea square units, keeping the
+// default 3:2 aspect, and scales factions, species and link reach to match.
+// Never shrinks below the default universe, and values given in the config
+// file are kept as they are.
+void scaleProfile(GenProfile &profile, unsigned realmCount) {
+    auto configured = [&profile](const char *key) { return profile.configured.count(key) > 0; };
+    double area = realmCount * profile.realmArea;
+    int width = sqrt(area * 3 / 2);
+    if (width > profile.width && !configured("width") && !configured("height")) {
+        profile.width = width;
+        profile.height = width * 2 / 3;
+    }
+    int factions = realmCount / REALMS_PER_FACTION;
+    if (factions > profile.factions && !configured("factions")) profile.factions = factions;
+    int species = realmCount / REALMS_PER_SPECIES;
+    if (species > profile.species && !configured("species")) profile.species = species;
+    double reach = sqrt(profile.realmArea / DEFAULT_REALM_AREA);
+    if (!configured("link_dist")) profile.maxLinkDist = ceil(MAX_LINK_DIST * reach);
+    if (!configured("min_dist"))  profile.minDist = ceil(MIN_REALM_DIST * reach);
+}
+
+// Rejects settings that can't make a usable universe. source names where
+// they came from for the error message.
+bool checkProfile(const GenProfile &profile, const std::string &source) {
+    if (profile.width < 1 || profile.height < 1) {
+        std::cerr << source << ": map extents must be positive.\n";
+        return false;
+    }
+    if (profile.minDist < 1) {
+        std::cerr << source << ": min_dist must be at least 1.\n";
+        return false;
+    }
+    if (profile.maxLinkDist <= profile.minDist) {
+        std::cerr << source << ": link_dist (" << profile.maxLinkDist << ") must be greater than min_dist (";
+        std::cerr << profile.minDist << ").\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads "key = value" lines; blank lines and lines starting with # are
+// ignored. realm_area is only used by --large scaling.
+bool loadProfile(const std::string &filename, GenProfile &profile) {
+    std::ifstream inf(filename);
+    if (!inf) {
+        std::cerr << "Failed to open profile " << filename << ".\n";
+        return false;
+    }
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(inf, line)) {
+        ++lineNo;
+        trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        auto parts = explode(line, '=');
+        if (parts.size() != 2) {
+            std::cerr << filename << ':' << lineNo << ": expected key = value.\n";
+            return false;
+        }
+        if (parts[0] == "realm_area") {
+            profile.realmArea = atof(parts[1].c_str());
+            if (profile.realmArea <= 0) {
+                std::cerr << filename << ':' << lineNo << ": realm_area must be positive.\n";
+                return false;
+            }
+            profile.configured.insert(parts[0]);
+            continue;
+        }
+
+        int value = strToInt(parts[1]);
+        if (value < 0) {
+            std::cerr << filename << ':' << lineNo << ": bad value \"" << parts[1] << "\".\n";
+            return false;
+        }
+        if (parts[0] == "width")            profile.width = value;
+        else if (parts[0] == "height")      profile.height = value;
+        else if (parts[0] == "factions")    profile.factions = value;
+        else if (parts[0] == "species")     profile.species = value;
+        else if (parts[0] == "link_dist")   profile.maxLinkDist = value;
+        else if (parts[0] == "min_dist")    profile.minDist = value;
+        else {
+            std::cerr << filename << ':' << lineNo << ": unknown key \"" << parts[0] << "\".\n";
+            return false;
+        }
+        profile.configured.insert(parts[0]);
+    }
+    return checkProfile(profile, filename);
+}
+
+// One bit per map position, used to reject realm positions that are too close
+// to an existing realm without scanning every realm placed so far.
+class PositionGrid {
+public:
+    PositionGrid(int width, int height)
+    : width(width), height(height), occupied(static_cast<size_t>(width) * height, false)
+    { }
+
+    void occupy(int x, int y) {
+        occupied[static_cast<size_t>(y) * width + x] = true;
+    }
+
+    // true if some occupied position lies strictly within minDist of x, y
+    bool nearOccupied(int x, int y, int minDist) const {
+        int reach = minDist > 0 ? minDist - 1 : -1;
+        for (int dy = -reach; dy <= reach; ++dy) {
+            int ty = y + dy;
+            if (ty < 0 || ty >= height) continue;
+            for (int dx = -reach; dx <= reach; ++dx) {
+                int tx = x + dx;
+                if (tx < 0 || tx >= width) continue;
+                if (dx * dx + dy * dy >= minDist * minDist) continue;
+                if (occupied[static_cast<size_t>(ty) * width + tx]) return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    int width, height;
+    std::vector<bool> occupied;
+};
+const int FACTION_MIN_DIST = 4;
 
 
 // https://stackoverflow.com/questions/9043805/test-if-two-lines-intersect-javascript-function
@@ -40,7 +192,70 @@ bool linesIntersect(double a, double b, double c, double d,
     }
 };
 
-bool validLink(World &world, Realm *origin, Realm *target, int minDist, int maxDist, int notWork, int notWorkLessThan) {
+// Buckets every link by the grid cells its bounding box covers. Two links
+// can only cross if their bounding boxes overlap, so checking a new link only
+// needs the links sharing a cell with it rather than every link in the world.
+class LinkGrid {
+public:
+    LinkGrid(int width, int height, int cellSize)
+    : cellSize(cellSize < 1 ? 1 : cellSize), stamp(0)
+    {
+        columns = width / this->cellSize + 1;
+        rows = height / this->cellSize + 1;
+        cells.resize(columns * rows);
+    }
+
+    void add(const Realm *a, const Realm *b) {
+        unsigned id = segments.size();
+        segments.push_back(Segment{a, b});
+        lastChecked.push_back(0);
+        forCells(a, b, [this, id](std::vector<unsigned> &cell) { cell.push_back(id); });
+    }
+
+    bool crossesLink(const Realm *origin, const Realm *target) {
+        ++stamp;
+        bool crosses = false;
+        forCells(origin, target, [&](std::vector<unsigned> &cell) {
+            for (unsigned id : cell) {
+                if (crosses || lastChecked[id] == stamp) continue;
+                lastChecked[id] = stamp;
+                const Segment &s = segments[id];
+                profileCount(ProfileCounter::IntersectTests);
+                if (linesIntersect(origin->x, origin->y, target->x, target->y,
+                                   s.a->x, s.a->y, s.b->x, s.b->y)) {
+                    crosses = true;
+                }
+            }
+        });
+        return crosses;
+    }
+
+private:
+    struct Segment {
+        const Realm *a, *b;
+    };
+
+    template<class F>
+    void forCells(const Realm *a, const Realm *b, F func) {
+        int left = std::min(a->x, b->x) / cellSize;
+        int right = std::max(a->x, b->x) / cellSize;
+        int top = std::min(a->y, b->y) / cellSize;
+        int bottom = std::max(a->y, b->y) / cellSize;
+        for (int y = top; y <= bottom && y < rows; ++y) {
+            for (int x = left; x <= right && x < columns; ++x) {
+                func(cells[y * columns + x]);
+            }
+        }
+    }
+
+    int cellSize, columns, rows;
+    unsigned stamp;
+    std::vector<Segment> segments;
+    std::vector<unsigned> lastChecked;
+    std::vector<std::vector<unsigned> > cells;
+};
+
+bool validLink(LinkGrid &links, Realm *origin, Realm *target, int minDist, int maxDist, int notWork, int notWorkLessThan) {
     if (!origin || !target) {
         return false;
     }
@@ -69,33 +284,161 @@ bool validLink(World &world, Realm *origin, Realm *target, int minDist, int maxD
         return false;
     }
 
-    for (Realm *a : world.realms) {
-        for (const Link &l : a->links) {
-            Realm *b = world.realmByIdent(l.linkTo);
-            if (a == origin && b == target) continue;
-            if (b == origin && a == target) continue;
-            if (linesIntersect(origin->x, origin->y, target->x, target->y,
-                               a->x, a->y, b->x, b->y)) {
-               return false;
-           }
-        }
+    if (links.crossesLink(origin, target)) {
+        return false;
     }
 
     return true;
 }
 
+// Offers the realms nearest to origin to accept(), nearest first with ties
+// going to the earlier realm, and returns the first one accepted. Gives up
+// after MAX_ITERATIONS - 1 candidates. Candidates come from the k-d tree a
+// few at a time, fetching more only when every one so far was refused.
+template<class Accept>
+Realm* nearestAccepted(World &world, Realm *origin, Accept accept) {
+    const unsigned limit = MAX_ITERATIONS - 1;
+    std::vector<KDTree::Hit> hits;
+    unsigned batch = 8, tried = 0;
+    while (tried < limit) {
+        // one more than wanted, since origin itself is always among them
+        unsigned want = std::min(batch, limit) + 1;
+        profileCount(ProfileCounter::NearestQueries);
+        world.positions.nearest(origin->x, origin->y, want, hits);
+
+        // the first candidates were already refused in an earlier round
+        unsigned skip = tried;
+        for (const KDTree::Hit &hit : hits) {
+            Realm *candidate = world.realms[hit.index];
+            if (candidate == origin) continue;
+            if (skip > 0) {
+                --skip;
+                continue;
+            }
+            if (tried > 0) profileCount(ProfileCounter::Retries);
+            ++tried;
+            if (accept(candidate)) return candidate;
+            profileCount(ProfileCounter::LinkRejections);
+            if (tried >= limit) return nullptr;
+        }
+        if (hits.size() < want) return nullptr;
+        batch *= 4;
+    }
+    return nullptr;
+}
+
+// Flood fills a linked group without recursion; large universes can have
+// groups far deeper than the call stack allows.
 int assignGroup(World &world, int rootIdent, int groupId) {
     int count = 0;
-    Realm *c = world.realmByIdent(rootIdent);
-    if (!c || c->work1 >= 0) return 0;
-    c->work1 = groupId;
-    ++count;
-    for (const Link &l : c->links) {
-        count += assignGroup(world, l.linkTo, groupId);
+    Realm *root = world.realmByIdent(rootIdent);
+    if (!root || root->work1 >= 0) return 0;
+    root->work1 = groupId;
+    std::vector<Realm*> pending{root};
+    while (!pending.empty()) {
+        Realm *c = pending.back();
+        pending.pop_back();
+        ++count;
+        for (const Link &l : c->links) {
+            Realm *t = world.realms[l.linkTo - 1];
+            if (t->work1 >= 0) continue;
+            t->work1 = groupId;
+            pending.push_back(t);
+        }
     }
     return count;
 }
 
+// Sets hops[i] for every realm world.realms[i] within maxHops transits of
+// origin and lists those realms in found, so the caller can reset just
+// them. Follows the realms' own links, as World::graph isn't built yet.
+void markNearby(World &world, Realm *origin, int maxHops, std::vector<int> &hops, std::vector<Realm*> &found) {
+    found.assign(1, origin);
+    hops[origin->ident - 1] = 0;
+    for (unsigned head = 0; head < found.size(); ++head) {
+        Realm *c = found[head];
+        int depth = hops[c->ident - 1];
+        if (depth == maxHops) continue;
+        for (const Link &l : c->links) {
+            Realm *t = world.realms[l.linkTo - 1];
+            if (hops[t->ident - 1] >= 0) continue;
+            hops[t->ident - 1] = depth + 1;
+            found.push_back(t);
+        }
+    }
+}
+
+// Hands out gateway bearings for one realm at a time, keeping every bearing
+// at least minSeparation degrees from the others. Taken bearings are kept
+// sorted so the free arcs are simply the gaps between neighbours.
+class BearingAllocator {
+public:
+    BearingAllocator(int minSeparation) : minSeparation(minSeparation) { }
+
+    void reset() {
+        taken.clear();
+    }
+
+    void take(int bearing) {
+        taken.insert(std::upper_bound(taken.begin(), taken.end(), bearing), bearing);
+    }
+
+    // Picks a bearing uniformly from the remaining free arc and takes it.
+    // Returns -1 if no bearing is far enough from the existing ones.
+    int allocate() {
+        if (taken.empty()) {
+            int bearing = rngNext(360);
+            take(bearing);
+            return bearing;
+        }
+
+        int totalFree = 0;
+        for (unsigned i = 0; i < taken.size(); ++i) {
+            totalFree += gapFree(i);
+        }
+        if (totalFree <= 0) return -1;
+
+        int pick = rngNext(totalFree);
+        for (unsigned i = 0; i < taken.size(); ++i) {
+            int free = gapFree(i);
+            if (pick < free) {
+                int bearing = (taken[i] + minSeparation + 1 + pick) % 360;
+                take(bearing);
+                return bearing;
+            }
+            pick -= free;
+        }
+        return -1;
+    }
+
+    // Fallback when allocate() fails: the middle of the widest gap.
+    int allocateWidest() {
+        if (taken.empty()) return allocate();
+        unsigned widest = 0;
+        for (unsigned i = 1; i < taken.size(); ++i) {
+            if (gapSize(i) > gapSize(widest)) widest = i;
+        }
+        int bearing = (taken[widest] + gapSize(widest) / 2) % 360;
+        take(bearing);
+        return bearing;
+    }
+
+private:
+    // angular distance from taken[i] to the next taken bearing clockwise
+    int gapSize(unsigned i) const {
+        if (i + 1 < taken.size()) return taken[i + 1] - taken[i];
+        return taken[0] + 360 - taken[i];
+    }
+    // number of whole-degree bearings inside gap i that respect the separation
+    int gapFree(unsigned i) const {
+        int free = gapSize(i) - 2 * minSeparation - 1;
+        return free > 0 ? free : 0;
+    }
+
+    int minSeparation;
+    std::vector<int> taken;
+};
+
 bool fileToList(const std::string &filename, std::vector<std::string> &theList) {
     std::ifstream inf(filename);
     if (!inf) {
@@ -114,13 +457,16 @@ bool fileToList(const std::string &filename, std::vector<std::string> &theList)
 int main(int argc, char *argv[]) {
     std::string realmNameFile = "realm_names.txt";
     std::string factionNameFile = "faction_names.txt";
+    std::string profileFile;
+    std::string reportFile;
     unsigned realmsToCreate = 500;
-    
+    bool largeWorld = false;
+
     // Process command line arguments
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "-h" || arg == "--help" || arg == "-v" || arg == "--version") {
-            std::cerr << "BIGBANG universe creator, Alpha\n";
+            std::cerr << "BIGBANG universe creator, " << VERSION << "\n";
             return 0;
         } else if (arg == "-c" || arg == "--count") {
             ++i;
@@ -133,11 +479,42 @@ int main(int argc, char *argv[]) {
                 std::cerr << "Realm count must be positive integer.\n";
                 return 1;
             } else realmsToCreate = count;
+        } else if (arg == "--large") {
+            largeWorld = true;
+        } else if (arg == "--config") {
+            ++i;
+            if (i >= argc) {
+                std::cerr << "Expected profile filename.\n";
+                return 1;
+            }
+            profileFile = argv[i];
+        } else if (arg == "--profile") {
+            ++i;
+            if (i >= argc) {
+                std::cerr << "Expected profile report filename.\n";
+                return 1;
+            }
+            reportFile = argv[i];
         } else {
             std::cerr << "Unknown argument " << arg << ".\n";
             return 1;
         }
     }
+    GenProfile profile = defaultProfile();
+    if (!profileFile.empty() && !loadProfile(profileFile, profile)) {
+        return 1;
+    }
+    if (largeWorld) {
+        scaleProfile(profile, realmsToCreate);
+        if (!checkProfile(profile, "--large")) return 1;
+    }
+    std::cerr << "Map is " << profile.width << "x" << profile.height;
+    std::cerr << " with up to " << profile.factions << " factions and ";
+    std::cerr << profile.species << " species.\n";
+    std::cerr << "Realms are at least " << profile.minDist << " apart with links up to ";
+    std::cerr << profile.maxLinkDist << " long.\n";
+
+    StageTimer timer("load names");
     // Load premade names from file
     fileToList(realmNameFile, realmNames);
     fileToList(factionNameFile, factionNames);
@@ -147,10 +524,10 @@ int main(int argc, char *argv[]) {
     // begin realms generation process
     rngInit(RNG_SEED);
     World world;
-
-    const int minDist = 3;
+    PositionGrid positions(profile.width, profile.height);
 
     std::cerr << "Allocating and positioning realms...\n";
+    timer.next("placement");
     for (unsigned i = 0; i < realmsToCreate; ++i) {
         Realm *r = new Realm;
         r->ident = i + 1;
@@ -158,13 +535,15 @@ int main(int argc, char *argv[]) {
         // generate realm location
         int x, y, iter = 0;
         do {
-            x = rngNext(MAX_WIDTH);
-            y = rngNext(MAX_HEIGHT);
+            x = rngNext(profile.width);
+            y = rngNext(profile.height);
             ++iter;
-        } while (iter < MAX_ITERATIONS && world.getNearest(x, y, -1, minDist));
+        } while (iter < MAX_ITERATIONS && positions.nearOccupied(x, y, profile.minDist));
+        profileCount(ProfileCounter::Retries, iter - 1);
         if (iter < MAX_ITERATIONS) {
             r->x = x;
             r->y = y;
+            positions.occupy(x, y);
         } else {
             delete r;
             std::cerr << "\tRealm generation terminated -- out of positions.\n";
@@ -177,32 +556,48 @@ int main(int argc, char *argv[]) {
     if (world.realms.size() <= 0) return 1;
 
     std::cerr << "Assigning realm details...\n";
+    timer.next("realm details");
+    if (world.realms.size() > realmNames.size()) {
+        std::vector<std::string> extraNames = makeNames(world.realms.size() - realmNames.size());
+        realmNames.insert(realmNames.end(), extraNames.begin(), extraNames.end());
+    }
     unsigned nextRealmName = 0;
     for (Realm *r : world.realms) {
-        if (nextRealmName < realmNames.size()) {
-            r->name = realmNames[nextRealmName];
-            ++nextRealmName;
-        } else {
-            r->name = makeName();
-        }
+        r->name = realmNames[nextRealmName];
+        ++nextRealmName;
         r->faction = -1;
         r->factionHome = false;
         r->primarySpecies = -1;
-        r->diameter = 412 + rngNext(208);
-        r->populationDensity = 15 + rngNext(70);
+        int diameter = 412 + rngNext(208);
+        int populationDensity = 15 + rngNext(70);
+        world.resizeRealm(r, diameter, populationDensity);
         r->biome = static_cast<Biome>(rngNext(static_cast<int>(Biome::BiomeCount)));
         for (Link &l : r->links) l.bearing = 0;
     }
 
 
     std::cerr << "Assigning initial links...\n";
+    timer.next("initial links");
+    world.rebuildPositions();
+    std::vector<KDTree::Hit> hits;
     for (Realm *r : world.realms) {
-        Realm *target = world.getNearest(r->x, r->y, r->ident);
-        if (!target) continue;
-        r->addLink(target);
+        profileCount(ProfileCounter::NearestQueries);
+        // the nearest hit is r itself
+        world.positions.nearest(r->x, r->y, 2, hits);
+        if (hits.size() < 2) continue;
+        r->addLink(world.realms[hits[1].index]);
+    }
+    // bigbang numbers realms consecutively, so world.realms[ident - 1] is the
+    // realm with that ident from here on
+    LinkGrid linkGrid(profile.width, profile.height, profile.maxLinkDist);
+    for (Realm *r : world.realms) {
+        for (const Link &l : r->links) {
+            if (l.linkTo > r->ident) linkGrid.add(r, world.realms[l.linkTo - 1]);
+        }
     }
 
     std::cerr << "Eliminating groups...\n";
+    timer.next("group elimination");
     int groupCount = 9, lastGroupCount = 4;
     while (groupCount > 1 && groupCount != lastGroupCount) {
         lastGroupCount = groupCount;
@@ -225,22 +620,11 @@ int main(int argc, char *argv[]) {
         for (Realm *r : world.realms) {
             if (groupsDone.count(r->work1)) continue;
 
-            int iter = 0;
-            Realm *target = nullptr;
-            std::vector<int> forbid{r->ident};
-            do {
-                ++iter;
-                if (iter >= MAX_ITERATIONS) break;
-                target = world.getNearest(r->x, r->y, forbid);
-                if (target) {
-                    forbid.push_back(target->ident);
-                    if (!validLink(world, r, target, 0, MAX_LINK_DIST, r->work1, -1000)) {
-                        target = nullptr;
-                    }
-                }
-            } while (!target);
-
+            Realm *target = nearestAccepted(world, r, [&](Realm *candidate) {
+                return validLink(linkGrid, r, candidate, 0, profile.maxLinkDist, r->work1, -1000);
+            });
             if (target && r->addLink(target)) {
+                linkGrid.add(r, target);
                 groupsDone.insert(r->work1);
                 groupsDone.insert(target->work1);
             }
@@ -251,116 +635,74 @@ int main(int argc, char *argv[]) {
     }
 
     std::cerr << "Expanding some leafs...\n";
+    timer.next("leaf expansion");
+    // a leaf may only link to a realm in its own group at least
+    // LEAF_MIN_HOPS transits away; new links never join groups, so the
+    // groups are found once and each leaf only searches its neighbourhood
+    for (Realm *r : world.realms) r->work1 = -1;
+    int nextGroup = 1;
+    for (Realm *r : world.realms) {
+        if (r->work1 < 0) assignGroup(world, r->ident, nextGroup++);
+    }
+    std::vector<int> hops(world.realms.size(), -1);
+    std::vector<Realm*> nearby;
     for (Realm *r : world.realms) {
         if (r->links.size() != 1) continue;
-        world.setDistances(r->ident);
-        int iter = 0;
-        Realm *target = nullptr;
-        std::vector<int> forbid{r->ident};
-        do {
-            ++iter;
-            if (iter >= MAX_ITERATIONS) break;
-            target = world.getNearest(r->x, r->y, forbid);
-            if (target) {
-                forbid.push_back(target->ident);
-                if (!validLink(world, r, target, 0, MAX_LINK_DIST, -1, 6)) {
-                    target = nullptr;
-                }
-            }
-        } while (!target);
-        r->addLink(target);
+        markNearby(world, r, LEAF_MIN_HOPS - 1, hops, nearby);
+        Realm *target = nearestAccepted(world, r, [&](Realm *candidate) {
+            if (candidate->work1 != r->work1 || hops[candidate->ident - 1] >= 0) return false;
+            return validLink(linkGrid, r, candidate, 0, profile.maxLinkDist, -1, -1000);
+        });
+        for (Realm *n : nearby) hops[n->ident - 1] = -1;
+        if (r->addLink(target)) linkGrid.add(r, target);
     }
 
     const int minDegrees = 35;
     std::cerr << "Determining gateway locations...\n";
+    timer.next("gateways");
+    BearingAllocator bearings(minDegrees);
+    int crowdedRealms = 0;
     for (Realm *r : world.realms) {
+        bearings.reset();
+        bearings.take(0);
         r->links[0].bearing = 0;
         r->links[0].distance = rngNext(50) + 25;
+        bool crowded = false;
         for (unsigned i = 1; i < r->links.size(); ++i) {
-            int bearing = -1;
-            do {
-                bearing = rngNext(360);
-
-                for (const Link &link : r->links) {
-                    if (bearing >= link.bearing - minDegrees && bearing <= link.bearing + minDegrees) bearing = -1;
-                    int test = bearing - 360;
-                    if (test >= link.bearing - minDegrees && test <= link.bearing + minDegrees) bearing = -1;
-                }
-            } while (bearing < 0);
+            int bearing = bearings.allocate();
+            if (bearing < 0) {
+                profileCount(ProfileCounter::Retries);
+                crowded = true;
+                bearing = bearings.allocateWidest();
+            }
             r->links[i].bearing = bearing;
 
             r->links[i].distance = rngNext(50) + 25;
         }
+        if (crowded) ++crowdedRealms;
+    }
+    if (crowdedRealms > 0) {
+        std::cerr << '\t' << crowdedRealms << " realms have too many gateways to keep them ";
+        std::cerr << minDegrees << " degrees apart.\n";
     }
 
     std::cerr << "Assigning factions...\n";
+    timer.next("factions");
     // allocate the faction data
-    for (unsigned i = 0; i < MAX_FACTIONS && i < realmsToCreate; ++i) {
+    unsigned factionCount = std::min<unsigned>(profile.factions, realmsToCreate);
+    if (factionCount > factionNames.size() + 1) {
+        std::vector<std::string> extraNames = makeNames(factionCount - factionNames.size() - 1);
+        factionNames.insert(factionNames.end(), extraNames.begin(), extraNames.end());
+    }
+    for (unsigned i = 0; i < factionCount; ++i) {
         Faction *f = makeFaction(factionNames);
         world.factions.push_back(f);
     }
 
     // determine realm factions
-    std::vector<Realm*> homes;
-    for (int i = 1; i < static_cast<int>(world.factions.size()); ++i) {
-        Realm *r = nullptr;
-        bool valid = false;
-        int iterations = 0;
-        do {
-            ++iterations;
-            if (iterations > MAX_ITERATIONS) {
-                valid = false;
-                break;
-            }
-            valid = true;
-            int id = 1 + rngNext(world.realms.size());
-            r = world.realmByIdent(id);
-            for (const Realm *c : homes) {
-                int dist = world.findPath(id, c->ident).size();
-                if (dist < 5) {
-                    valid = false;
-                    break;
-                }
-            }
-
-        } while (!valid);
-        if (!valid) {
-            std::cerr << "\tFailed to place faction " << i << ".\n";
-        } else {
-            r->faction = i;
-            r->factionHome = true;
-            world.factions[i]->home = r->ident;
-            homes.push_back(r);
-        }
-    }
-
-    int assigned;
-    do {
-        assigned = 0;
-        for (Realm *r : world.realms) {
-            if (r->faction >= 0) continue;
-            std::map<int, int> neighbors;
-            for (const Link &l : r->links) {
-                const Realm *t = world.realmByIdent(l.linkTo);
-                if (t && t->faction > 0) {
-                    ++neighbors[t->faction];
-                }
-            }
-
-            if (neighbors.size() > 1) {
-                r->faction = 0;
-                ++assigned;
-            } else if (neighbors.size() == 1) {
-                r->faction = neighbors.begin()->first;
-                ++assigned;
-            }
-        }
-    } while (assigned > 0);
-
-    // clean up any missed factions
-    for (Realm *r : world.realms) {
-        if (r->faction < 0) r->faction = 0;
-    }
+    world.rebuildGraph();
+    placeFactionHomes(world, FACTION_MIN_DIST);
+    growTerritories(world);
 
     // std::cerr << "Placing species...\n";
     // Realm *home = nullptr;
@@ -399,8 +741,14 @@ int main(int argc, char *argv[]) {
     // } while(home);
 
     std::cerr << "Building species...\n";
-    for (unsigned i = 0; i < MAX_SPECIES; ++i) {
-        Species *s = makeSpecies();
+    timer.next("species");
+    std::vector<std::string> speciesNames;
+    unsigned speciesCount = profile.species;
+    if (speciesCount > sapientSpecies.size()) {
+        speciesNames = makeNames(speciesCount - sapientSpecies.size());
+    }
+    for (unsigned i = 0; i < speciesCount; ++i) {
+        Species *s = makeSpecies(speciesNames);
         world.species.push_back(s);
     }
 
@@ -415,6 +763,18 @@ int main(int argc, char *argv[]) {
     }
 
     std::cerr << "Saving data to file...\n";
+    timer.next("save");
     world.writeToFile("realms.txt");
+    timer.finish();
+
+    std::cerr << '\n';
+    profileReport(std::cerr);
+    if (!reportFile.empty()) {
+        if (profileWriteJSON(reportFile, VERSION, world.realms.size())) {
+            std::cerr << "Wrote profile report to " << reportFile << ".\n";
+        } else {
+            std::cerr << "Failed to write profile report to " << reportFile << ".\n";
+        }
+    }
     return 0;
 }
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <vector>
+
+#include "realms.h"
+
+static bool hitBefore(const KDTree::Hit &l, const KDTree::Hit &r) {
+    if (l.distSq != r.distSq) return l.distSq < r.distSq;
+    return l.index < r.index;
+}
+
+void KDTree::build(const std::vector<Realm*> &realms) {
+    nodes.clear();
+    nodes.reserve(realms.size());
+    for (unsigned i = 0; i < realms.size(); ++i) {
+        nodes.push_back(Node{ realms[i]->x, realms[i]->y, i });
+    }
+    buildRange(0, nodes.size(), 0);
+}
+
+void KDTree::buildRange(unsigned lo, unsigned hi, int axis) {
+    if (hi - lo < 2) return;
+    unsigned mid = lo + (hi - lo) / 2;
+    std::nth_element(nodes.begin() + lo, nodes.begin() + mid, nodes.begin() + hi,
+            [axis](const Node &l, const Node &r) {
+                return axis == 0 ? l.x < r.x : l.y < r.y;
+            });
+    buildRange(lo, mid, 1 - axis);
+    buildRange(mid + 1, hi, 1 - axis);
+}
+
+// Fills hits with the k realms closest to (x, y). The search keeps the best
+// k seen so far in a max-heap, so a subtree is skipped as soon as its
+// splitting line is farther away than the worst of them.
+void KDTree::nearest(int x, int y, unsigned k, std::vector<Hit> &hits) const {
+    hits.clear();
+    if (k == 0) return;
+    searchNearest(0, nodes.size(), 0, x, y, k, hits);
+    std::sort_heap(hits.begin(), hits.end(), hitBefore);
+}
+
+void KDTree::searchNearest(unsigned lo, unsigned hi, int axis, int x, int y, unsigned k,
+                           std::vector<Hit> &heap) const {
+    if (lo >= hi) return;
+    unsigned mid = lo + (hi - lo) / 2;
+    const Node &node = nodes[mid];
+
+    long long dx = x - node.x, dy = y - node.y;
+    Hit hit{ node.index, dx * dx + dy * dy };
+    if (heap.size() < k) {
+        heap.push_back(hit);
+        std::push_heap(heap.begin(), heap.end(), hitBefore);
+    } else if (hitBefore(hit, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), hitBefore);
+        heap.back() = hit;
+        std::push_heap(heap.begin(), heap.end(), hitBefore);
+    }
+
+    long long split = axis == 0 ? dx : dy;
+    if (split < 0) {
+        searchNearest(lo, mid, 1 - axis, x, y, k, heap);
+        if (heap.size() < k || split * split <= heap.front().distSq) {
+            searchNearest(mid + 1, hi, 1 - axis, x, y, k, heap);
+        }
+    } else {
+        searchNearest(mid + 1, hi, 1 - axis, x, y, k, heap);
+        if (heap.size() < k || split * split <= heap.front().distSq) {
+            searchNearest(lo, mid, 1 - axis, x, y, k, heap);
+        }
+    }
+}
+
+// Fills hits with every realm no farther than radius from (x, y).
+void KDTree::within(int x, int y, int radius, std::vector<Hit> &hits) const {
+    hits.clear();
+    if (radius < 0) return;
+    searchWithin(0, nodes.size(), 0, x, y, static_cast<long long>(radius) * radius, hits);
+    std::sort(hits.begin(), hits.end(), hitBefore);
+}
+
+void KDTree::searchWithin(unsigned lo, unsigned hi, int axis, int x, int y, long long radiusSq,
+                          std::vector<Hit> &hits) const {
+    if (lo >= hi) return;
+    unsigned mid = lo + (hi - lo) / 2;
+    const Node &node = nodes[mid];
+
+    long long dx = x - node.x, dy = y - node.y;
+    long long distSq = dx * dx + dy * dy;
+    if (distSq <= radiusSq) hits.push_back(Hit{ node.index, distSq });
+
+    long long split = axis == 0 ? dx : dy;
+    if (split <= 0 || split * split <= radiusSq) searchWithin(lo, mid, 1 - axis, x, y, radiusSq, hits);
+    if (split >= 0 || split * split <= radiusSq) searchWithin(mid + 1, hi, 1 - axis, x, y, radiusSq, hits);
+}
+
+// Fills indexes with every realm in the rectangle from (left, top) to
+// (right, bottom), edges included, in no particular order.
+void KDTree::inside(int left, int top, int right, int bottom, std::vector<unsigned> &indexes) const {
+    indexes.clear();
+    searchInside(0, nodes.size(), 0, left, top, right, bottom, indexes);
+}
+
+void KDTree::searchInside(unsigned lo, unsigned hi, int axis, int left, int top, int right, int bottom,
+                          std::vector<unsigned> &indexes) const {
+    if (lo >= hi) return;
+    unsigned mid = lo + (hi - lo) / 2;
+    const Node &node = nodes[mid];
+    if (node.x >= left && node.x <= right && node.y >= top && node.y <= bottom) {
+        indexes.push_back(node.index);
+    }
+
+    int split = axis == 0 ? node.x : node.y;
+    int low = axis == 0 ? left : top;
+    int high = axis == 0 ? right : bottom;
+    if (low <= split)  searchInside(lo, mid, 1 - axis, left, top, right, bottom, indexes);
+    if (high >= split) searchInside(mid + 1, hi, 1 - axis, left, top, right, bottom, indexes);
+}
@@ -1,6 +1,8 @@
 #include <algorithm>
+#include <cctype>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iostream>
@@ -12,350 +14,487 @@
 
 #include "realms.h"
 
-void showHelp(World &world, const std::vector<std::string> &arguments);
+void showHelp(World &world, const CommandArgs &arguments, std::ostream &out);
 
-void makeGViz(World &world, const std::vector<std::string> &arguments);
-void makeJSON(World &world, const std::vector<std::string> &arguments);
-void makeSQL(World &world, const std::vector<std::string> &arguments);
-void makeSVG(World &world, const std::vector<std::string> &arguments);
-void statsDispatcher(World &world, const std::vector<std::string> &arguments);
-void listDispatcher(World &world, const std::vector<std::string> &arguments);
+void makeGViz(World &world, const CommandArgs &arguments, std::ostream &out);
+void makeJSON(World &world, const CommandArgs &arguments, std::ostream &out);
+void makeSQL(World &world, const CommandArgs &arguments, std::ostream &out);
+void makeSVG(World &world, const CommandArgs &arguments, std::ostream &out);
+void statsDispatcher(World &world, const CommandArgs &arguments, std::ostream &out);
+void listDispatcher(World &world, const CommandArgs &arguments, std::ostream &out);
 
-void findPath(World &world, const std::vector<std::string> &arguments) {
-    int from = strToInt(arguments[1]);
-    int to = strToInt(arguments[2]);
-    if (from < 0 || to < 0) return;
+// Queries may run on several batch workers or server connections at once,
+// so each thread searches with its own scratch space.
+SearchScratch& searchScratch() {
+    static thread_local SearchScratch scratch;
+    return scratch;
+}
+
+void findPath(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int from = arguments.value(1);
+    int to = arguments.value(2);
 
-    std::cout << "Path from " << from << " to " << to << ": ";
-    auto path = world.findPath(from, to);
+    out << "Path from " << from << " to " << to << ": ";
+    auto path = world.findPath(from, to, searchScratch());
     bool first = true;
     for (int i : path) {
         if (first) first = false;
-        else        std::cout << " -> ";
-        std::cout << i;
+        else        out << " -> ";
+        out << i;
     }
-    std::cout << "\nDistance: " << path.size() << "\n\n";
+    out << "\nDistance: " << path.size() << "\n\n";
 }
 
-void findDistance(World &world, const std::vector<std::string> &arguments) {
-    int from = strToInt(arguments[1]);
-    int to = strToInt(arguments[2]);
-    if (from < 0 || to < 0) return;
+void findDistance(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int from = arguments.value(1);
+    int to = arguments.value(2);
 
-    std::cout << "Distance from " << from << " to " << to << ": ";
-    std::cout << world.findDistance(from, to) << "\n\n";
+    out << "Distance from " << from << " to " << to << ": ";
+    out << world.findDistance(from, to, searchScratch()) << "\n\n";
 }
 
-bool realmNearSort(const Realm *l, const Realm *r) {
-    if (l->work2 < r->work2) return true;
-    if (l->work2 > r->work2) return false;
-    return l->name < r->name;
+typedef std::pair<int, const Realm*> RealmAndDist;
+bool realmNearSort(const RealmAndDist &l, const RealmAndDist &r) {
+    if (l.first < r.first) return true;
+    if (l.first > r.first) return false;
+    return l.second->name < r.second->name;
 }
-void findNear(World &world, const std::vector<std::string> &arguments) {
-    int to = strToInt(arguments[1]);
-    int dist = strToInt(arguments[2]);
-    if (to < 0 || dist < 1) {
-        std::cout << "Invalid argument.\n\n";
-        return;
-    }
+void findNear(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int to = arguments.value(1);
+    int dist = arguments.value(2);
 
-    std::vector<Realm*> work;
-    for (Realm *r : world.realms) {
-        if (r->ident == to) continue;
-        int d = world.findDistance(to, r->ident);
-        if (d <= dist) {
-            r->work2 = d;
-            work.push_back(r);
-        }
+    std::vector<RealmAndDist> work;
+    for (const RealmHops &found : world.realmsWithin(to, dist, searchScratch())) {
+        work.push_back(RealmAndDist(found.second, found.first));
     }
     std::sort(work.begin(), work.end(), realmNearSort);
 
-    std::cout << "     REALM                   DIST  SPECIES\n";
-    for (const Realm *r : work) {
+    out << "     REALM                   DIST  SPECIES\n";
+    for (const RealmAndDist &entry : work) {
+        const Realm *r = entry.second;
         Species *s = world.speciesByIdent(r->primarySpecies);
-        std::cout << std::setw(3) << r->ident << ": ";
-        std::cout << std::left << std::setw(MAX_NAME_LENGTH) << r->name << std::right << "    ";
-        std::cout << std::setw(4) << r->work2;
-        std::cout << "   " << s->name << " [" << s->ident << "]\n";
+        out << std::setw(3) << r->ident << ": ";
+        out << std::left << std::setw(MAX_NAME_LENGTH) << r->name << std::right << "    ";
+        out << std::setw(4) << entry.first;
+        out << "   " << s->name << " [" << s->ident << "]\n";
     }
-    std::cout << '\n';
+    out << '\n';
 }
 
-void findNearXY(World &world, const std::vector<std::string> &arguments) {
-    int X = strToInt(arguments[1]);
-    int Y = strToInt(arguments[2]);
-    int count = 1;
-    if (arguments.size() > 3) count = strToInt(arguments[3]);
-    if (X < 0 || Y < 1 || count < 1) {
-        std::cout << "Invalid argument.\n\n";
-        return;
+void findNearXY(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int X = arguments.value(1);
+    int Y = arguments.value(2);
+    int count = arguments.value(3);
+
+    std::vector<KDTree::Hit> hits;
+    world.positions.nearest(X, Y, count, hits);
+    if (!hits.empty()) {
+        // widen to every realm tied with the farthest hit so ties are
+        // settled by name, as the listing is sorted
+        long long farthest = hits.back().distSq;
+        world.positions.within(X, Y, ceil(sqrt(farthest)), hits);
+        while (!hits.empty() && hits.back().distSq > farthest) hits.pop_back();
     }
-
-    std::vector<Realm*> work;
-    for (Realm *r : world.realms) {
-        r->work2 = distance(r->x, r->y, X, Y) * 1000;
-        work.push_back(r);
+    std::vector<RealmAndDist> work;
+    for (const KDTree::Hit &hit : hits) {
+        const Realm *r = world.realms[hit.index];
+        work.push_back(RealmAndDist(sqrt(hit.distSq) * 1000, r));
     }
     std::sort(work.begin(), work.end(), realmNearSort);
+    if (work.size() > static_cast<unsigned>(count)) work.resize(count);
 
-    std::cout << "     REALM                   DIST  X   Y   HR  PRIMARY SPECIES\n";
-    for (unsigned i = 0; i < work.size() && i < static_cast<unsigned>(count); ++i) {
-        const Realm *r = work[i];
+    out << "     REALM                   DIST  X   Y   HR  PRIMARY SPECIES\n";
+    for (unsigned i = 0; i < work.size(); ++i) {
+        const Realm *r = work[i].second;
         Species *s = world.speciesByIdent(r->primarySpecies);
-        std::cout << std::setw(3) << r->ident << ": ";
-        std::cout << std::left << std::setw(MAX_NAME_LENGTH) << r->name << std::right;
-        std::cout << std::setw(8) << r->work2 / 1000.0 << "  ";
-        std::cout << std::left << std::setw(4) << r->x;
-        std::cout << std::setw(4) << r->y << std::right;
-        std::cout << "    " << s->name << " [" << s->ident << "]\n";
+        out << std::setw(3) << r->ident << ": ";
+        out << std::left << std::setw(MAX_NAME_LENGTH) << r->name << std::right;
+        out << std::setw(8) << work[i].first / 1000.0 << "  ";
+        out << std::left << std::setw(4) << r->x;
+        out << std::setw(4) << r->y << std::right;
+        out << "    " << s->name << " [" << s->ident << "]\n";
     }
-    std::cout << '\n';
+    out << '\n';
 }
 
-void randomRealm(World &world, const std::vector<std::string> &arguments) {
-    unsigned count = 1;
-    if (arguments.size() > 1) count = strToInt(arguments[1]);
-    if (count < 1) {
-        std::cout << "Invalid argument.\n\n";
-        return;
-    }
-
+void randomRealm(World &world, const CommandArgs &arguments, std::ostream &out) {
+    unsigned count = arguments.value(1);
     if (count > world.realms.size()) {
-        std::cout << "Selection count cannot be greater than realm count. (Asked for ";
-        std::cout << count << " realms, but only " << world.realms.size() << " exist.)\n\n";
+        out << "Selection count cannot be greater than realm count. (Asked for ";
+        out << count << " realms, but only " << world.realms.size() << " exist.)\n\n";
         return;
     }
 
     std::vector<const Realm*> work;
-    while (work.size() < count) {
-        int rng = rngNext(world.realms.size());
-        Realm *s = world.realms[rng];
-        bool isDup = false;
-        for (const Realm *r : work) {
-            if (r == s) isDup = true;
-            break;
+    if (arguments.value(2) < 0) {
+        for (unsigned i : rngSample(world.realms.size(), count)) work.push_back(world.realms[i]);
+    } else {
+        // split the realms into strata and give each a share of the sample
+        // in proportion to its size, with the leftover picks going to the
+        // largest remainders
+        std::map<int, std::vector<const Realm*> > strata;
+        for (const Realm *r : world.realms) {
+            switch (arguments.value(2)) {
+                case 0: strata[r->faction].push_back(r);                    break;
+                case 1: strata[r->primarySpecies].push_back(r);             break;
+                case 2: strata[static_cast<int>(r->biome)].push_back(r);    break;
+            }
+        }
+
+        std::vector<unsigned> quota;
+        std::vector<std::pair<unsigned long long, unsigned> > remainders;
+        unsigned assigned = 0;
+        for (const auto &stratum : strata) {
+            unsigned long long share = static_cast<unsigned long long>(count) * stratum.second.size();
+            quota.push_back(share / world.realms.size());
+            remainders.push_back(std::make_pair(share % world.realms.size(), quota.size() - 1));
+            assigned += quota.back();
+        }
+        std::stable_sort(remainders.begin(), remainders.end(),
+                [](const std::pair<unsigned long long, unsigned> &l, const std::pair<unsigned long long, unsigned> &r) {
+                    return l.first > r.first;
+                });
+        for (unsigned i = 0; assigned < count; ++i, ++assigned) ++quota[remainders[i].second];
+
+        unsigned next = 0;
+        for (const auto &stratum : strata) {
+            for (unsigned i : rngSample(stratum.second.size(), quota[next++])) {
+                work.push_back(stratum.second[i]);
+            }
         }
-        if (!isDup) work.push_back(s);
     }
 
-    std::cout << "     REALM                   PRIMARY SPECIES\n";
+    out << "     REALM                   PRIMARY SPECIES\n";
     for (const Realm *r : work) {
         Species *s = world.speciesByIdent(r->primarySpecies);
-        std::cout << std::setw(3) << r->ident << ": ";
-        std::cout << std::left << std::setw(MAX_NAME_LENGTH) << r->name << std::right << "    ";
-        std::cout << "    " << s->name << " [" << s->ident << "]\n";
+        out << std::setw(3) << r->ident << ": ";
+        out << std::left << std::setw(MAX_NAME_LENGTH) << r->name << std::right << "    ";
+        out << "    " << s->name << " [" << s->ident << "]\n";
     }
-    std::cout << '\n';
+    out << '\n';
 }
 
-void showRealm(World &world, const std::vector<std::string> &arguments) {
-    int from = strToInt(arguments[1]);
-    if (from < 0) {
-        std::cout << "Invalid argument.\n\n";
-        return;
-    }
-
+void showRealm(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int from = arguments.value(1);
     Realm *r = world.realmByIdent(from);
     if (!r) {
-        std::cout << "Invalid ident " << from << ".\n\n";
+        out << "Invalid ident " << from << ".\n\n";
         return;
     }
 
-    std::cout << r->name << " [" << r->ident << "]\n";
-    std::cout << "Map Position: " << r->x << ", " << r->y << "\n";
-    std::cout << "Links:";
+    out << r->name << " [" << r->ident << "]\n";
+    out << "Map Position: " << r->x << ", " << r->y << "\n";
+    out << "Links:";
     for (const Link &l : r->links) {
-        std::cout << " <" << l.linkTo;
-        std::cout << ' ' << l.distance << "% @ " << l.bearing << " deg.>";
+        out << " <" << l.linkTo;
+        out << ' ' << l.distance << "% @ " << l.bearing << " deg.>";
     }
-    std::cout << "\nDiameter: " << r->diameter << " mi.\n";
-    std::cout << "Area: " << intToString(r->area()) << " sq mi.\n";
-    std::cout << "Pop. Density: " << r->populationDensity << " per sq mi.\n";
-    std::cout << "Population: " << intToString(r->population()) << "\n";
-    std::cout << "Biome: " << r->biome << "\n";
+    out << "\nDiameter: " << r->diameter << " mi.\n";
+    out << "Area: " << intToString(r->area()) << " sq mi.\n";
+    out << "Pop. Density: " << r->populationDensity << " per sq mi.\n";
+    out << "Population: " << intToString(r->population()) << "\n";
+    out << "Biome: " << r->biome << "\n";
     const Species *s = world.speciesByIdent(r->primarySpecies);
     if (s) {
-        std::cout << "Primary species: " << s->name;
-        std::cout << " [" << r->primarySpecies << "]";
-        std::cout << '\n';
+        out << "Primary species: " << s->name;
+        out << " [" << r->primarySpecies << "]";
+        out << '\n';
     }
 
-    std::cout << "\n";
+    out << "\n";
 }
 
-void showSpecies(World &world, const std::vector<std::string> &arguments) {
-    int from = strToInt(arguments[1]);
-    Species *s = nullptr;
-    if (from >= 0) {
-        s = world.speciesByIdent(from);
-    }
+void showSpecies(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int from = arguments.value(1);
+    Species *s = world.speciesByIdent(from);
     if (!s) {
-        std::cout << "Invalid species " << arguments[1] << ".\n\n";
+        out << "Invalid species " << from << ".\n\n";
         return;
     }
 
-    std::cout << s->name << " [" << s->ident << "]\n";
-    std::cout << "Height: " << s->height << " cm\n";
-    std::cout << "Stance: " << s->stance << "\n";
-    std::cout << "Wings: " << s->wings << "\n";
-    std::cout << '\n';
+    out << s->name << " [" << s->ident << "]\n";
+    out << "Height: " << s->height << " cm\n";
+    out << "Stance: " << s->stance << "\n";
+    out << "Wings: " << s->wings << "\n";
+    out << '\n';
 }
 
 
-void checkNames(World &world, const std::vector<std::string> &arguments) {
-    std::cout << "Factions:\n" << std::left;
+void checkNames(World &world, const CommandArgs &arguments, std::ostream &out) {
+    out << "Factions:\n" << std::left;
     for (Faction *r : world.factions) {
         if (r->name.size() > MAX_NAME_LENGTH) {
-            std::cout << '\t' << std::setw(3) << r->ident << "  " << r->name << '\n';
+            out << '\t' << std::setw(3) << r->ident << "  " << r->name << '\n';
         }
     }
-    std::cout << '\n' << std::right;
+    out << '\n' << std::right;
 
-    std::cout << "Realms:\n" << std::left;
+    out << "Realms:\n" << std::left;
     for (Realm *r : world.realms) {
         if (r->name.size() > MAX_NAME_LENGTH) {
-            std::cout << '\t' << std::setw(3) << r->ident << "  " << r->name << '\n';
+            out << '\t' << std::setw(3) << r->ident << "  " << r->name << '\n';
         }
     }
-    std::cout << '\n' << std::right;
+    out << '\n' << std::right;
 
-    std::cout << "Species:\n" << std::left;
+    out << "Species:\n" << std::left;
     for (Species *r : world.species) {
         if (r->name.size() > MAX_NAME_LENGTH) {
-            std::cout << '\t' << std::setw(3) << r->ident << "  " << r->name << '\n';
+            out << '\t' << std::setw(3) << r->ident << "  " << r->name << '\n';
         }
     }
 
     // check species abbreviations are unique
-    std::cout << "\nSpecies Abbreviations:\n" << std::left;
+    out << "\nSpecies Abbreviations:\n" << std::left;
     for (Species *a : world.species) {
         for (Species *b : world.species) {
             // if (a == b) continue;
             if (a->ident >= b->ident) continue;
             if (a->abbrev == b->abbrev) {
-                std::cout << '\t';
-                std::cout << std::setw(MAX_NAME_LENGTH) << a->name << " <> ";
-                std::cout << std::setw(MAX_NAME_LENGTH) << b->name << "\n";
+                out << '\t';
+                out << std::setw(MAX_NAME_LENGTH) << a->name << " <> ";
+                out << std::setw(MAX_NAME_LENGTH) << b->name << "\n";
             }
         }
     }
-    std::cout << '\n' << std::right;
+    out << '\n' << std::right;
 }
 
 
-typedef void (*cmdHandler)(World&, const std::vector<std::string>&);
+typedef void (*cmdHandler)(World&, const CommandArgs&, std::ostream&);
+
+enum class ArgType {
+    Int, Word, Choice
+};
+struct ArgInfo {
+    std::string name;   // for a choice, the accepted words separated by '|'
+    ArgType type;
+    bool optional;
+    int minValue;       // smallest integer accepted
+    int defaultValue;   // value used when an optional argument is left out
+};
+ArgInfo intArg(const char *name, int minValue = 0) {
+    return ArgInfo{ name, ArgType::Int, false, minValue, -1 };
+}
+ArgInfo optionalIntArg(const char *name, int minValue, int defaultValue) {
+    return ArgInfo{ name, ArgType::Int, true, minValue, defaultValue };
+}
+ArgInfo optionalWordArg(const char *name) {
+    return ArgInfo{ name, ArgType::Word, true, 0, -1 };
+}
+ArgInfo choiceArg(const char *choices) {
+    return ArgInfo{ choices, ArgType::Choice, false, 0, -1 };
+}
+ArgInfo optionalChoiceArg(const char *choices) {
+    return ArgInfo{ choices, ArgType::Choice, true, 0, -1 };
+}
+
 struct CommandInfo {
     std::string name;
     cmdHandler func;
-    unsigned minArgs, maxArgs;
-    std::string usage, description;
+    bool concurrent; // only reads the world, so may run alongside other queries
+    std::vector<ArgInfo> args;
+    std::string description;
 };
+// kept sorted by name so commands can be found by binary search
 std::vector<CommandInfo> commands{
-    { "checknames",    checkNames,      1, 1, "",
-                                              "Check length of names does not exceed maximum." },
-    { "dist",          findDistance,    3, 3, "(from) (to)",
-                                              "Finds the minimum number of transits required to travel between two realms." },
-    { "dot",           makeGViz,         1, 1, "",
-                                              "Outputs GraphViz dot file." },
-    { "help",          showHelp,        1, 2, "[command]",
-                                              "Display list of valid commands. If a command is specified, displays information on command usage instead." },
-    { "json",          makeJSON,        1, 1, "",
-                                              "Outputs realms data as JSON." },
-    { "list",          listDispatcher,  2, 3, "(factions|realms|species) [sort by]",
-                                              "Displays list of all factions, realms, or species." },
-    { "near",          findNear,        3, 3, "(to realm) (within distance)",
-                                              "Display a list of realms within a certain distance of the one specified." },
-    { "nearxy",        findNearXY,      3, 4, "(x) (y) [count]",
-                                              "Display up to count realms closest to the provided visual XY coordinates. If not specified, count is 1." },
-    { "path",          findPath,        3, 3, "(from) (to)",
-                                              "Finds the shortest path between two realms." },
-    { "quit",          nullptr,         1, 1, "",
-                                              "Exit program." },
-    { "q",             nullptr,         1, 1, "",
-                                              "Exit program." },
-    { "random",        randomRealm,     1, 2, "[count]",
-                                              "Select one or more random realms. If unspecified, count is 1." },
-    { "realm",         showRealm,       2, 2, "(realm id)",
-                                              "Displays realm information." },
-    { "species",       showSpecies,     2, 2, "(species id)",
-                                              "Displays species information" },
-    { "sql",           makeSQL,         1, 1, "",
-                                              "Creates SQL file with realms data." },
-    { "svg",           makeSVG,         1, 1, "",
-                                              "Outputs map of all realm connects as an SVG file." },
-    { "stats",         statsDispatcher, 2, 2, "(faction|realm|species)",
-                                              "Calculate and display stats for one of factions, realms, or species." },
+    { "checknames",    checkNames,      true,  { },
+                                        "Check length of names does not exceed maximum." },
+    { "dist",          findDistance,    true,  { intArg("from"), intArg("to") },
+                                        "Finds the minimum number of transits required to travel between two realms." },
+    { "dot",           makeGViz,        false, { },
+                                        "Outputs GraphViz dot file." },
+    { "help",          showHelp,        true,  { optionalWordArg("command") },
+                                        "Display list of valid commands. If a command is specified, displays information on command usage instead." },
+    { "json",          makeJSON,        false, { },
+                                        "Outputs realms data as JSON." },
+    { "list",          listDispatcher,  false, { choiceArg("factions|realms|species"), optionalWordArg("sort by") },
+                                        "Displays list of all factions, realms, or species." },
+    { "near",          findNear,        true,  { intArg("to realm"), intArg("within distance", 1) },
+                                        "Display a list of realms within a certain distance of the one specified." },
+    { "nearxy",        findNearXY,      true,  { intArg("x"), intArg("y"), optionalIntArg("count", 1, 1) },
+                                        "Display up to count realms closest to the provided visual XY coordinates. If not specified, count is 1." },
+    { "path",          findPath,        true,  { intArg("from"), intArg("to") },
+                                        "Finds the shortest path between two realms." },
+    { "q",             nullptr,         false, { },
+                                        "Exit program." },
+    { "quit",          nullptr,         false, { },
+                                        "Exit program." },
+    { "random",        randomRealm,     false, { optionalIntArg("count", 1, 1), optionalChoiceArg("faction|species|biome") },
+                                        "Select one or more random realms. If unspecified, count is 1. If a faction, species, or biome is given, the selection is stratified by it so each group is represented in proportion to its size." },
+    { "realm",         showRealm,       true,  { intArg("realm id") },
+                                        "Displays realm information." },
+    { "species",       showSpecies,     true,  { intArg("species id") },
+                                        "Displays species information" },
+    { "sql",           makeSQL,         false, { },
+                                        "Creates SQL file with realms data." },
+    { "stats",         statsDispatcher, false, { choiceArg("faction|realm|species") },
+                                        "Calculate and display stats for one of factions, realms, or species." },
+    { "svg",           makeSVG,         false, { optionalChoiceArg("svg|svgz"), optionalIntArg("label spacing", 0, 0) },
+                                        "Outputs map of all realm connects as an SVG file, gzip compressed if svgz is given. With a label spacing, only one realm in each square that many map units across is labelled." },
 };
 
-void showHelp(World &world, const std::vector<std::string> &arguments) {
+const CommandInfo* findCommand(const char *name, unsigned length) {
+    auto iter = std::lower_bound(commands.begin(), commands.end(), std::make_pair(name, length),
+            [](const CommandInfo &c, const std::pair<const char*, unsigned> &key) {
+                return c.name.compare(0, std::string::npos, key.first, key.second) < 0;
+            });
+    if (iter == commands.end() || iter->name.compare(0, std::string::npos, name, length) != 0) {
+        return nullptr;
+    }
+    return &*iter;
+}
+
+// Position of word among the '|' separated choices, or -1 if it isn't one.
+int choiceIndex(const std::string &choices, const char *word, unsigned length) {
+    int index = 0;
+    std::string::size_type start = 0;
+    while (true) {
+        std::string::size_type end = choices.find('|', start);
+        if (end == std::string::npos) end = choices.size();
+        if (end - start == length && choices.compare(start, length, word, length) == 0) return index;
+        if (end == choices.size()) return -1;
+        start = end + 1;
+        ++index;
+    }
+}
+
+// Parses a non-negative decimal integer, rejecting anything past INT_MAX.
+bool parseArgInt(const char *text, unsigned length, int &value) {
+    long long result = 0;
+    if (length == 0 || length > 10) return false;
+    for (unsigned i = 0; i < length; ++i) {
+        if (text[i] < '0' || text[i] > '9') return false;
+        result = result * 10 + (text[i] - '0');
+    }
+    if (result > 0x7FFFFFFF) return false;
+    value = result;
+    return true;
+}
+
+std::string commandUsage(const CommandInfo &cmd) {
+    std::string usage;
+    for (const ArgInfo &arg : cmd.args) {
+        if (!usage.empty()) usage += ' ';
+        usage += arg.optional ? '[' : '(';
+        usage += arg.name;
+        usage += arg.optional ? ']' : ')';
+    }
+    return usage;
+}
+
+bool CommandArgs::is(unsigned i, const char *word) const {
+    return strlen(word) == length[i] && strncmp(start[i], word, length[i]) == 0;
+}
+
+
+void showHelp(World &world, const CommandArgs &arguments, std::ostream &out) {
     if (arguments.size() > 1) {
-        for (const CommandInfo &cmd : commands) {
-            if (cmd.name == arguments[1]) {
-                std::cout << cmd.name << ' ' << cmd.usage << "\n\n";
-                std::cout << cmd.description << "\n\n";
-                return;
-            }
+        const std::string name = arguments.text(1);
+        const CommandInfo *cmd = findCommand(name.c_str(), name.size());
+        if (!cmd) {
+            out << "Unknown command \"" << name << "\".\n";
+            return;
+        }
+        out << cmd->name << ' ' << commandUsage(*cmd) << "\n\n";
+        out << cmd->description << "\n\n";
+        for (const ArgInfo &arg : cmd->args) {
+            if (arg.type != ArgType::Int) continue;
+            out << "  " << std::left << std::setw(16) << arg.name << std::right;
+            out << "number, at least " << arg.minValue;
+            if (arg.optional) out << ", default " << arg.defaultValue;
+            out << '\n';
         }
-        std::cout << "Unknown command \"" << arguments[1] << "\".\n";
         return;
     }
 
-    std::cout << "Valid commands:\n" << std::left;
+    out << "Valid commands:\n" << std::left;
     for (const CommandInfo &cmd : commands) {
-        std::cout << "  " << std::setw(12) << cmd.name << "  " << cmd.usage << "\n";
+        out << "  " << std::setw(12) << cmd.name << "  " << commandUsage(cmd) << "\n";
     }
+    out << std::right;
 }
 
-bool processCommand(World &world, std::string commandText) {
-    auto parts = explodeOnWhitespace(commandText);
-    if (parts.empty()) return false;
-
-    const CommandInfo *cmd = nullptr;
-    for (const CommandInfo &c : commands) {
-        if (c.name == parts[0]) {
-            cmd = &c;
+bool processCommand(World &world, std::string commandText, std::ostream &out) {
+    // split into words in place; a word past the last slot marks overflow
+    CommandArgs arguments;
+    arguments.count = 0;
+    bool overflow = false;
+    const char *p = commandText.c_str();
+    while (*p) {
+        while (isspace(static_cast<unsigned char>(*p))) ++p;
+        if (!*p) break;
+        const char *wordStart = p;
+        while (*p && !isspace(static_cast<unsigned char>(*p))) ++p;
+        if (arguments.count == MAX_COMMAND_WORDS) {
+            overflow = true;
             break;
         }
+        arguments.start[arguments.count] = wordStart;
+        arguments.length[arguments.count] = p - wordStart;
+        ++arguments.count;
     }
+    if (arguments.count == 0) return false;
 
-    if (cmd) {
-        if (cmd->func)  {
-            if (parts.size() < cmd->minArgs || parts.size() > cmd->maxArgs) {
-                std::cout << "Invalid argument count. Try \"help " << cmd->name << "\" for usage.\n\n";
-            } else cmd->func(world, parts);
-        }
-        else            return true;
-    } else {
-        std::cout << "Unknown command \"" << trim(commandText) << "\"\n\n";
+    const CommandInfo *cmd = findCommand(arguments.start[0], arguments.length[0]);
+    if (!cmd) {
+        out << "Unknown command \"" << trim(commandText) << "\"\n\n";
+        return false;
     }
-    return false;
-}
+    if (!cmd->func) return true;
 
-int main(int argc, char *argv[]) {
-    rngInit(0);
-    World world;
-    if (!world.readFromFile("realms.txt")) {
-        std::cerr << "Failed to read realms data.\n";
-        return 1;
+    unsigned required = 0;
+    for (const ArgInfo &arg : cmd->args) {
+        if (!arg.optional) ++required;
     }
-    std::cout << "Read " << world.realms.size() << " realms.\n";
-    std::cout << "Read " << world.factions.size() << " factions.\n";
-    std::cout << "Read " << world.species.size() << " species.\n\n";
-
-    if (argc > 1) {
-        for (int i = 1; i < argc; ++i) {
-            std::cout << "> " << argv[i] << "\n";
-            if (processCommand(world, argv[i])) break;
-        }
-        return 0;
+    if (overflow || arguments.count - 1 < required || arguments.count - 1 > cmd->args.size()) {
+        out << "Invalid argument count. Try \"help " << cmd->name << "\" for usage.\n\n";
+        return false;
     }
 
-    while (1) {
-        std::string input;
-        std::cout << "> ";
-        std::getline(std::cin, input);
-        if (processCommand(world, input)) break;
+    for (unsigned i = 0; i < cmd->args.size(); ++i) {
+        const ArgInfo &arg = cmd->args[i];
+        int &value = arguments.values[i + 1];
+        if (i + 1 >= arguments.count) {
+            value = arg.defaultValue;
+            continue;
+        }
+        const char *text = arguments.start[i + 1];
+        unsigned length = arguments.length[i + 1];
+        bool valid = true;
+        switch (arg.type) {
+            case ArgType::Int:
+                valid = parseArgInt(text, length, value) && value >= arg.minValue;
+                break;
+            case ArgType::Choice:
+                value = choiceIndex(arg.name, text, length);
+                valid = value >= 0;
+                break;
+            case ArgType::Word:
+                value = -1;
+                break;
+        }
+        if (!valid) {
+            if (arg.type == ArgType::Choice) out << "Must specify one of " << arg.name << ", not ";
+            else                             out << "Invalid " << arg.name << ' ';
+            out << '"' << arguments.text(i + 1) << "\". ";
+            out << "Try \"help " << cmd->name << "\" for usage.\n\n";
+            return false;
+        }
     }
 
-    return 0;
+    cmd->func(world, arguments, out);
+    return false;
+}
+
+bool isConcurrentCommand(const std::string &commandText) {
+    const char *p = commandText.c_str();
+    while (isspace(static_cast<unsigned char>(*p))) ++p;
+    const char *wordStart = p;
+    while (*p && !isspace(static_cast<unsigned char>(*p))) ++p;
+    if (p == wordStart) return true;
+
+    const CommandInfo *cmd = findCommand(wordStart, p - wordStart);
+    if (!cmd) return true;
+    return cmd->concurrent && cmd->func;
 }
@@ -3,6 +3,8 @@
 
 #include <iosfwd>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 const int MAX_NAME_LENGTH = 20;
@@ -52,9 +54,12 @@ struct Realm {
     int faction;
     bool factionHome;
     int work1, work2;
+    // derived from diameter and populationDensity by updateMetrics()
+    long long cachedArea = 0, cachedPopulation = 0;
 
-    int area() const;
-    int population() const;
+    long long area() const { return cachedArea; }
+    long long population() const { return cachedPopulation; }
+    void updateMetrics();
 
     bool addLink(Realm *target);
     bool hasLink(int to);
@@ -68,11 +73,79 @@ struct Faction {
     int home;
 };
 
+// Compact adjacency used by graph searches. Realms are addressed by their
+// position in World::realms and all links live in one flat array; the links
+// of realm i are linkTarget[firstLink[i]] up to linkTarget[firstLink[i+1]].
+struct RealmGraph {
+    std::vector<unsigned> firstLink;
+    std::vector<unsigned> linkTarget;
+    std::unordered_map<int, unsigned> identIndex;
+
+    void build(const std::vector<Realm*> &realms);
+    int indexOf(int ident) const;
+    unsigned size() const { return identIndex.size(); }
+};
+
+// Static 2-d tree over realm map positions. Realms are addressed by their
+// position in the vector the tree was built from; queries return hits nearest
+// first, with ties going to the lower index.
+class KDTree {
+public:
+    struct Hit {
+        unsigned index;
+        long long distSq;
+    };
+
+    void build(const std::vector<Realm*> &realms);
+    void nearest(int x, int y, unsigned k, std::vector<Hit> &hits) const;
+    void within(int x, int y, int radius, std::vector<Hit> &hits) const;
+    void inside(int left, int top, int right, int bottom, std::vector<unsigned> &indexes) const;
+    unsigned size() const { return nodes.size(); }
+
+private:
+    struct Node {
+        int x, y;
+        unsigned index;
+    };
+    // nodes[lo, hi) is a subtree whose splitting node sits at its middle;
+    // splits alternate between x and y with depth
+    std::vector<Node> nodes;
+
+    void buildRange(unsigned lo, unsigned hi, int axis);
+    void searchNearest(unsigned lo, unsigned hi, int axis, int x, int y, unsigned k,
+                       std::vector<Hit> &heap) const;
+    void searchWithin(unsigned lo, unsigned hi, int axis, int x, int y, long long radiusSq,
+                      std::vector<Hit> &hits) const;
+    void searchInside(unsigned lo, unsigned hi, int axis, int left, int top, int right, int bottom,
+                      std::vector<unsigned> &indexes) const;
+};
+
+// Working space for graph searches. Each thread keeps its own, so searches
+// can share one World without writing to the realms' work fields.
+struct SearchScratch {
+    std::vector<int> distance;
+    std::vector<unsigned> queue;
+    // all -1 between searches, so bounded searches only reset what they visit
+    std::vector<int> hops;
+};
+
+typedef std::pair<const Realm*, int> RealmHops;
+
 struct World {
     std::vector<Realm*> realms;
     std::vector<Faction*> factions;
     std::vector<Species*> species;
+    RealmGraph graph;
+    KDTree positions;
     int maxX, maxY;
+    // sums of every realm's cached metrics, kept current by updateMetrics()
+    // and resizeRealm()
+    unsigned long long totalArea = 0, totalPopulation = 0;
+    // replaced by markChanged() whenever realms are edited, so anything
+    // cached from the world can tell it is out of date. Revisions come from
+    // one counter shared by every World and are never reused, so a cache
+    // can't mistake a new world for an old one at the same address.
+    unsigned long revision = newRevision();
 
     bool writeToFile(const std::string &filename) const;
     bool readFromFile(const std::string &filename);
@@ -84,9 +157,19 @@ struct World {
     Faction* factionByIdent(int ident);
     Species* speciesByIdent(int ident);
     std::vector<int> findPath(int from, int to);
+    std::vector<int> findPath(int from, int to, SearchScratch &scratch) const;
     int findDistance(int from, int to);
+    int findDistance(int from, int to, SearchScratch &scratch) const;
+    void distancesFrom(int ident, SearchScratch &scratch, int stopAt = -1) const;
+    std::vector<RealmHops> realmsWithin(int ident, int maxHops, SearchScratch &scratch) const;
     void setDistances(int ident);
     int factionSize(int ident) const;
+    void rebuildGraph();
+    void rebuildPositions();
+    void updateMetrics();
+    void resizeRealm(Realm *realm, int diameter, int populationDensity);
+    void markChanged() { revision = newRevision(); }
+    static unsigned long newRevision();
 };
 
 std::ostream& operator<<(std::ostream &out, const Biome &biome);
@@ -104,11 +187,69 @@ int strToInt(const std::string &text);
 std::string intToString(long long number);
 void rngInit(int seed);
 int rngNext(int max);
+std::vector<unsigned> rngSample(unsigned population, unsigned count);
 
 // bb_generator.cpp
 std::string makeName();
+std::vector<std::string> makeNames(unsigned count);
 Faction* makeFaction(const std::vector<std::string> &factionNames);
-Species* makeSpecies();
+Species* makeSpecies(const std::vector<std::string> &speciesNames);
+
+// bb_territory.cpp
+int placeFactionHomes(World &world, int minHops);
+void growTerritories(World &world);
+
+// bb_profiler.cpp
+enum class ProfileCounter {
+    NearestQueries, LinkRejections, IntersectTests, Retries,
+    Count
+};
+extern unsigned long long profileCounters[];
+inline void profileCount(ProfileCounter counter, unsigned long long amount = 1) {
+    profileCounters[static_cast<int>(counter)] += amount;
+}
+
+// Times consecutive generation stages; next() closes the running stage and
+// opens another, and the destructor closes the last one.
+class StageTimer {
+public:
+    explicit StageTimer(const std::string &name);
+    ~StageTimer();
+    void next(const std::string &name);
+    void finish();
+private:
+    void start(const std::string &name);
+    std::string stageName;
+    double startTime;
+    unsigned long long startCounters[static_cast<int>(ProfileCounter::Count)];
+    bool running;
+};
+long peakMemoryKB();
+void profileReport(std::ostream &out);
+bool profileWriteJSON(const std::string &filename, const std::string &version, unsigned realmCount);
+
+// realms.cpp
+const unsigned MAX_COMMAND_WORDS = 4;
+// A command line split in place: word 0 is the command name and the others
+// are its arguments, each checked against the command's schema. value(i)
+// is the number given for an integer argument, the position in the list of
+// choices for a choice argument, or the default when an optional argument
+// was left out.
+class CommandArgs {
+public:
+    unsigned size() const { return count; }
+    int value(unsigned i) const { return values[i]; }
+    bool is(unsigned i, const char *word) const;
+    std::string text(unsigned i) const { return std::string(start[i], length[i]); }
+private:
+    const char *start[MAX_COMMAND_WORDS];
+    unsigned length[MAX_COMMAND_WORDS];
+    int values[MAX_COMMAND_WORDS];
+    unsigned count;
+    friend bool processCommand(World &world, std::string commandText, std::ostream &out);
+};
+bool processCommand(World &world, std::string commandText, std::ostream &out);
+bool isConcurrentCommand(const std::string &commandText);
 
 
 template<class T>
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "realms.h"
+
+// Batch mode: answers a stream of commands in input order. Runs of commands
+// that only read the world (see CommandInfo::concurrent) are shared out over
+// a worker pool; any other command waits for the run before it to finish and
+// then executes alone, so its effects are seen by everything after it.
+
+const unsigned BATCH_CHUNK_SIZE = 4096;
+
+
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threadCount);
+    ~WorkerPool();
+    // Calls job(i) for every i below count and returns once all are done.
+    // The calling thread works through the jobs alongside the pool.
+    void run(unsigned count, const std::function<void(unsigned)> &job);
+
+private:
+    void workerMain();
+    void drain();
+
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable wake, finished;
+    const std::function<void(unsigned)> *currentJob;
+    unsigned jobCount;
+    std::atomic<unsigned> nextJob;
+    unsigned busyWorkers;
+    unsigned generation;
+    bool stopping;
+};
+
+WorkerPool::WorkerPool(unsigned threadCount)
+: currentJob(nullptr), jobCount(0), nextJob(0), busyWorkers(0), generation(0), stopping(false) {
+    for (unsigned i = 0; i < threadCount; ++i) {
+        threads.push_back(std::thread(&WorkerPool::workerMain, this));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : threads) t.join();
+}
+
+void WorkerPool::run(unsigned count, const std::function<void(unsigned)> &job) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        currentJob = &job;
+        jobCount = count;
+        nextJob = 0;
+        busyWorkers = threads.size();
+        ++generation;
+    }
+    wake.notify_all();
+    drain();
+
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [this]() { return busyWorkers == 0; });
+    currentJob = nullptr;
+}
+
+void WorkerPool::drain() {
+    for (unsigned i = nextJob++; i < jobCount; i = nextJob++) {
+        (*currentJob)(i);
+    }
+}
+
+void WorkerPool::workerMain() {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        drain();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            --busyWorkers;
+        }
+        finished.notify_one();
+    }
+}
+
+
+// Reads commands from in, a chunk at a time, and writes each chunk's output
+// in one piece once every command in it has run. Stops at end of input or
+// at a quit command. Returns the number of commands processed.
+unsigned runBatch(World &world, std::istream &in, std::ostream &out) {
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    WorkerPool pool(threadCount - 1);
+
+    std::vector<std::string> commands;
+    std::vector<std::string> results;
+    std::string line, buffer;
+    unsigned processed = 0;
+    bool quit = false;
+
+    while (!quit) {
+        commands.clear();
+        while (commands.size() < BATCH_CHUNK_SIZE && std::getline(in, line)) {
+            commands.push_back(line);
+        }
+        if (commands.empty()) break;
+        results.assign(commands.size(), std::string());
+
+        unsigned start = 0;
+        while (start < commands.size() && !quit) {
+            unsigned end = start;
+            while (end < commands.size() && isConcurrentCommand(commands[end])) ++end;
+            if (end > start) {
+                pool.run(end - start, [&](unsigned i) {
+                    std::ostringstream result;
+                    processCommand(world, commands[start + i], result);
+                    results[start + i] = result.str();
+                });
+            }
+            if (end < commands.size()) {
+                std::ostringstream result;
+                quit = processCommand(world, commands[end], result);
+                results[end] = result.str();
+                ++end;
+            }
+            processed += end - start;
+            start = end;
+        }
+
+        buffer.clear();
+        for (unsigned i = 0; i < start; ++i) buffer += results[i];
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+    }
+    return processed;
+}
@@ -3,7 +3,7 @@
 #include <iostream>
 #include "realms.h"
 
-void makeGViz(World &world, const std::vector<std::string> &arguments) {
+void makeGViz(World &world, const CommandArgs &arguments, std::ostream &out) {
     std::ofstream dotfile("realms.dot");
     int showWhat = 0;
 
@@ -46,5 +46,5 @@ void makeGViz(World &world, const std::vector<std::string> &arguments) {
     }
     dotfile << "}\n";
 
-    std::cout << "Wrote dot file to realms.sql\n\n";
+    out << "Wrote dot file to realms.sql\n\n";
 }
@@ -3,7 +3,7 @@
 #include <iostream>
 #include "realms.h"
 
-void makeJSON(World &world, const std::vector<std::string> &arguments) {
+void makeJSON(World &world, const CommandArgs &arguments, std::ostream &out) {
     std::ofstream jsonFile("realms.js");
 
     jsonFile << "const realmsDB = {\n\t\"realms\": [\n";
@@ -71,5 +71,5 @@ void makeJSON(World &world, const std::vector<std::string> &arguments) {
     jsonFile << "\t],\n";
     jsonFile << "}\n";
 
-    std::cout << "Wrote JSON file to realms.js\n\n";
+    out << "Wrote JSON file to realms.js\n\n";
 }
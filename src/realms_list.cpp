@@ -9,60 +9,135 @@
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "realms.h"
 
-World *w = nullptr;
-
-bool realmNameSort(const Realm *l, const Realm *r) {
-    return l->name < r->name;
+// Sort orders and per-species totals for the list command. Name ranks are
+// worked out once per world revision and every order is a permutation of
+// indexes built from them the first time it is asked for. list only runs
+// with sole use of the world, so one shared cache is enough.
+struct ListIndex {
+    const World *world = nullptr;
+    unsigned long revision = 0;
+
+    // position of each realm, faction and species in name order
+    std::vector<int> realmNameRank, factionNameRank, speciesNameRank;
+    std::vector<unsigned> realmsByName, factionsByName, speciesByName;
+    std::vector<unsigned> realmsBySpecies, realmsByFaction;
+    std::unordered_map<int, unsigned> factionPos, speciesPos;
+
+    std::vector<unsigned> speciesFrequency;
+    std::vector<long long> speciesPopulation;
+};
+static ListIndex listIndex;
+
+template<class T>
+static void rankByName(const std::vector<T*> &items, std::vector<unsigned> &order, std::vector<int> &rank) {
+    order.resize(items.size());
+    for (unsigned i = 0; i < items.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&items](unsigned l, unsigned r) {
+        if (items[l]->name != items[r]->name) return items[l]->name < items[r]->name;
+        return l < r;
+    });
+    rank.resize(items.size());
+    for (unsigned i = 0; i < order.size(); ++i) rank[order[i]] = i;
 }
-bool realmSpeciesSort(const Realm *l, const Realm *r) {
-    Species *ls = w->speciesByIdent(l->primarySpecies);
-    Species *rs = w->speciesByIdent(r->primarySpecies);
-    return ls->name < rs->name;
+
+// Realm order by a per-realm key, then by realm name.
+static void orderRealms(const std::vector<int> &key, std::vector<unsigned> &order) {
+    const std::vector<int> &nameRank = listIndex.realmNameRank;
+    order.resize(key.size());
+    for (unsigned i = 0; i < key.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](unsigned l, unsigned r) {
+        if (key[l] != key[r]) return key[l] < key[r];
+        return nameRank[l] < nameRank[r];
+    });
 }
-bool realmFactionSort(const Realm *l, const Realm *r) {
-    if (l->faction <= 0 && r->faction <= 0) {
-        return realmNameSort(l, r);
-    }
 
-    if (l->faction >= 0 && r->faction < 0) return false;
-    if (l->faction < 0 && r->faction >= 0) return true;
+static ListIndex& currentListIndex(const World &world) {
+    ListIndex &index = listIndex;
+    // the sizes are checked too, as a guard against a world edited without
+    // markChanged()
+    if (index.world == &world && index.revision == world.revision
+            && index.realmNameRank.size() == world.realms.size()
+            && index.factionNameRank.size() == world.factions.size()
+            && index.speciesNameRank.size() == world.species.size()) {
+        return index;
+    }
+    index = ListIndex();
+    index.world = &world;
+    index.revision = world.revision;
+
+    rankByName(world.realms, index.realmsByName, index.realmNameRank);
+    rankByName(world.factions, index.factionsByName, index.factionNameRank);
+    rankByName(world.species, index.speciesByName, index.speciesNameRank);
+    for (unsigned i = 0; i < world.factions.size(); ++i) index.factionPos[world.factions[i]->ident] = i;
+    for (unsigned i = 0; i < world.species.size(); ++i) index.speciesPos[world.species[i]->ident] = i;
+
+    index.speciesFrequency.assign(world.species.size(), 0);
+    index.speciesPopulation.assign(world.species.size(), 0);
+    for (const Realm *r : world.realms) {
+        auto pos = index.speciesPos.find(r->primarySpecies);
+        if (pos == index.speciesPos.end()) continue;
+        ++index.speciesFrequency[pos->second];
+        index.speciesPopulation[pos->second] += r->population();
+    }
+    return index;
+}
 
-    Faction *ls = w->factionByIdent(l->faction);
-    Faction *rs = w->factionByIdent(r->faction);
-    return ls->name < rs->name;
+// Unknown species sort first.
+static const std::vector<unsigned>& realmsBySpecies(const World &world, ListIndex &index) {
+    if (index.realmsBySpecies.empty() && !world.realms.empty()) {
+        std::vector<int> key(world.realms.size());
+        for (unsigned i = 0; i < world.realms.size(); ++i) {
+            auto pos = index.speciesPos.find(world.realms[i]->primarySpecies);
+            key[i] = pos == index.speciesPos.end() ? -1 : index.speciesNameRank[pos->second];
+        }
+        orderRealms(key, index.realmsBySpecies);
+    }
+    return index.realmsBySpecies;
 }
 
-void listRealms(World &world, const std::vector<std::string> &arguments) {
-    if (arguments.size() > 3) {
-        std::cout << "Excess elements in command.\nUSAGE: list factions [sort]\n\n";
-        return;
+// Unclaimed realms and unknown factions sort first.
+static const std::vector<unsigned>& realmsByFaction(const World &world, ListIndex &index) {
+    if (index.realmsByFaction.empty() && !world.realms.empty()) {
+        std::vector<int> key(world.realms.size());
+        for (unsigned i = 0; i < world.realms.size(); ++i) {
+            auto pos = index.factionPos.find(world.realms[i]->faction);
+            key[i] = pos == index.factionPos.end() ? -1 : index.factionNameRank[pos->second];
+        }
+        orderRealms(key, index.realmsByFaction);
     }
+    return index.realmsByFaction;
+}
 
-    std::vector<Realm*> sorted = world.realms;
+void listRealms(World &world, const CommandArgs &arguments, std::ostream &out) {
+    ListIndex &index = currentListIndex(world);
+    const std::vector<unsigned> *order = nullptr;
     if (arguments.size() > 2) {
-        w = &world;
-        if (arguments[2] == "name") std::sort(sorted.begin(), sorted.end(), realmNameSort);
-        else if (arguments[2] == "species") std::sort(sorted.begin(), sorted.end(), realmSpeciesSort);
-        else if (arguments[2] == "faction") std::sort(sorted.begin(), sorted.end(), realmFactionSort);
+        if (arguments.is(2, "name")) order = &index.realmsByName;
+        else if (arguments.is(2, "species")) order = &realmsBySpecies(world, index);
+        else if (arguments.is(2, "faction")) order = &realmsByFaction(world, index);
         else {
-            std::cout << "Unknown sort key \"" << arguments[2] << "\".\n\n";
+            out << "Unknown sort key \"" << arguments.text(2) << "\".\n\n";
             return;
         }
     }
 
-    for (const Realm *s : sorted) {
-        const Faction *fac = world.factionByIdent(s->faction);
-        const Species *spc = world.speciesByIdent(s->primarySpecies);
+    for (unsigned i = 0; i < world.realms.size(); ++i) {
+        const Realm *s = world.realms[order ? (*order)[i] : i];
+        auto facPos = index.factionPos.find(s->faction);
+        auto spcPos = index.speciesPos.find(s->primarySpecies);
+        const Faction *fac = facPos == index.factionPos.end() ? nullptr : world.factions[facPos->second];
+        const Species *spc = spcPos == index.speciesPos.end() ? nullptr : world.species[spcPos->second];
 
-        std::cout << std::left;
-        std::cout << std::setw(3) << s->ident << "  ";
-        std::cout << std::setw(20) << s->name << "  ";
-        if (s->factionHome) std::cout << "H ";
-        else                std::cout << "  ";
+        out << std::left;
+        out << std::setw(3) << s->ident << "  ";
+        out << std::setw(20) << s->name << "  ";
+        if (s->factionHome) out << "H ";
+        else                out << "  ";
 
         std::stringstream facStr;
         if (fac) {
@@ -80,103 +155,73 @@ void listRealms(World &world, const std::vector<std::string> &arguments) {
             spcStr << "BAD SPECIES [" << s->primarySpecies << "]";
         }
 
-        std::cout << std::setw(24) << facStr.str() << "  " << std::setw(24) << spcStr.str() << '\n';
+        out << std::setw(24) << facStr.str() << "  " << std::setw(24) << spcStr.str() << '\n';
     }
-    std::cout << '\n';
-}
-
-bool factionNameSort(const Faction *l, const Faction *r) {
-    return l->name < r->name;
+    out << '\n';
 }
 
-void listFactions(World &world, const std::vector<std::string> &arguments) {
-    std::map<int, int> population;
-    std::map<int, int> frequency;
-
-    if (arguments.size() > 3) {
-        std::cout << "Excess elements in command.\nUSAGE: list factions [sort]\n\n";
-        return;
-    }
-
-    std::vector<Faction*> sorted = world.factions;
+void listFactions(World &world, const CommandArgs &arguments, std::ostream &out) {
+    ListIndex &index = currentListIndex(world);
+    const std::vector<unsigned> *order = nullptr;
     if (arguments.size() > 2) {
-        if (arguments[2] == "name") std::sort(sorted.begin(), sorted.end(), factionNameSort);
+        if (arguments.is(2, "name")) order = &index.factionsByName;
         else {
-            std::cout << "Unknown sort key \"" << arguments[2] << "\".\n\n";
+            out << "Unknown sort key \"" << arguments.text(2) << "\".\n\n";
             return;
         }
     }
 
-    for (const Faction *s : sorted) {
-        const Realm *home = world.realmByIdent(s->home);
+    for (unsigned i = 0; i < world.factions.size(); ++i) {
+        const Faction *s = world.factions[order ? (*order)[i] : i];
+        int homePos = world.graph.indexOf(s->home);
+        const Realm *home = homePos < 0 ? nullptr : world.realms[homePos];
 
-        std::cout << std::left;
-        std::cout << std::setw(3) << s->ident << "  ";
-        std::cout << std::setw(20) << s->name << "  ";
+        out << std::left;
+        out << std::setw(3) << s->ident << "  ";
+        out << std::setw(20) << s->name << "  ";
         if (home) {
-            std::cout << home->name << " [" << home->ident << "]";
+            out << home->name << " [" << home->ident << "]";
         } else if (s->home == -1) {
-            std::cout << "no home realm";
+            out << "no home realm";
         } else {
-            std::cout << "BAD REALM [" << s->home << "]";
+            out << "BAD REALM [" << s->home << "]";
         }
-        std::cout << '\n';
+        out << '\n';
     }
-    std::cout << '\n';
+    out << '\n';
 }
 
 
-bool speciesNameSort(const Species *l, const Species *r) {
-    return l->name < r->name;
-}
-
-void listSpecies(World &world, const std::vector<std::string> &arguments) {
-    std::map<int, int> population;
-    std::map<int, int> frequency;
-
-    if (arguments.size() > 3) {
-        std::cout << "Excess elements in command.\nUSAGE: list species [sort]\n\n";
-        return;
-    }
-
-    std::vector<Species*> sorted = world.species;
+void listSpecies(World &world, const CommandArgs &arguments, std::ostream &out) {
+    ListIndex &index = currentListIndex(world);
+    const std::vector<unsigned> *order = nullptr;
     if (arguments.size() > 2) {
-        if (arguments[2] == "name") std::sort(sorted.begin(), sorted.end(), speciesNameSort);
+        if (arguments.is(2, "name")) order = &index.speciesByName;
         else {
-            std::cout << "Unknown sort key \"" << arguments[2] << ".\n\n";
+            out << "Unknown sort key \"" << arguments.text(2) << "\".\n\n";
             return;
         }
     }
 
-    for (const Species *s : sorted) {
-        std::cout << std::left;
-        std::cout << std::setw(3) << s->ident << "  ";
-        std::cout << std::setw(24) << s->name << "  ";
-        std::cout << std::setw(3) << frequency[s->ident] << " (";
-        std::cout << percent(frequency[s->ident], world.realms.size()) << "%)  ";
-        std::cout << std::setw(24) << intToString(population[s->ident]) << "\n";
+    for (unsigned i = 0; i < world.species.size(); ++i) {
+        unsigned pos = order ? (*order)[i] : i;
+        const Species *s = world.species[pos];
+        out << std::left;
+        out << std::setw(3) << s->ident << "  ";
+        out << std::setw(24) << s->name << "  ";
+        out << std::setw(3) << index.speciesFrequency[pos] << " (";
+        out << percent(index.speciesFrequency[pos], world.realms.size()) << "%)  ";
+        out << std::setw(24) << intToString(index.speciesPopulation[pos]) << "\n";
     }
-    std::cout << '\n';
+    out << '\n';
 }
 
 
-void listDispatcher(World &world, const std::vector<std::string> &arguments) {
-    if (arguments.size() >= 2) {
-        if (arguments[1] == "species") {
-            listSpecies(world, arguments);
-            return;
-        }
-
-        if (arguments[1] == "realms") {
-            listRealms(world, arguments);
-            return;
-        }
-
-        if (arguments[1] == "factions") {
-            listFactions(world, arguments);
-            return;
-        }
+void listDispatcher(World &world, const CommandArgs &arguments, std::ostream &out) {
+    // the choices are declared as factions|realms|species
+    switch (arguments.value(1)) {
+        case 0: listFactions(world, arguments, out); break;
+        case 1: listRealms(world, arguments, out);   break;
+        case 2: listSpecies(world, arguments, out);  break;
     }
-
-    std::cout << "Must specify 'factions', 'realms', or 'species'.\n\n";
 }
@@ -0,0 +1,62 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "realms.h"
+
+unsigned runBatch(World &world, std::istream &in, std::ostream &out);
+int runServer(World &world, const std::string &socketPath);
+
+int main(int argc, char *argv[]) {
+    // batch and server modes keep stdout for command output alone
+    bool batch = argc == 3 && std::string(argv[1]) == "-batch";
+    bool server = argc == 3 && std::string(argv[1]) == "-server";
+    // batches read from stdin; this must come before any stream output
+    if (batch && std::string(argv[2]) == "-") std::ios::sync_with_stdio(false);
+
+    rngInit(0);
+    World world;
+    if (!world.readFromFile("realms.txt")) {
+        std::cerr << "Failed to read realms data.\n";
+        return 1;
+    }
+
+    std::ostream &info = batch || server ? std::cerr : std::cout;
+    info << "Read " << world.realms.size() << " realms.\n";
+    info << "Read " << world.factions.size() << " factions.\n";
+    info << "Read " << world.species.size() << " species.\n\n";
+
+    if (server) return runServer(world, argv[2]);
+    if (batch) {
+        std::string filename = argv[2];
+        if (filename == "-") {
+            runBatch(world, std::cin, std::cout);
+            return 0;
+        }
+        std::ifstream in(filename);
+        if (!in) {
+            std::cerr << "Failed to open " << filename << ".\n";
+            return 1;
+        }
+        runBatch(world, in, std::cout);
+        return 0;
+    }
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            std::cout << "> " << argv[i] << "\n";
+            if (processCommand(world, argv[i], std::cout)) break;
+        }
+        return 0;
+    }
+
+    while (1) {
+        std::string input;
+        std::cout << "> ";
+        std::getline(std::cin, input);
+        if (processCommand(world, input, std::cout)) break;
+    }
+
+    return 0;
+}
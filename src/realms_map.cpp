@@ -1,6 +1,12 @@
-#include <fstream>
-#include <iomanip>
+#include <cstdio>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <zlib.h>
+
 #include "realms.h"
 
 struct Colour { int r; int g; int b; };
@@ -34,10 +40,109 @@ std::vector<Colour> colourList = {
 };
 
 
-void makeSVG(World &world, const std::vector<std::string> &arguments) {
+// Collects the SVG text in a buffer and hands it to the file in large
+// blocks, through zlib when writing .svgz.
+class SvgOutput {
+public:
+    explicit SvgOutput(const std::string &filename, bool compress) : plain(nullptr), packed(nullptr) {
+        if (compress) packed = gzopen(filename.c_str(), "wb");
+        else          plain = fopen(filename.c_str(), "wb");
+        buffer.reserve(BUFFER_SIZE + 1024);
+    }
+    ~SvgOutput() { close(); }
+
+    bool isOpen() const { return plain || packed; }
+    bool close() {
+        flush();
+        bool ok = !failed;
+        if (plain && fclose(plain) != 0) ok = false;
+        if (packed && gzclose(packed) != Z_OK) ok = false;
+        plain = nullptr;
+        packed = nullptr;
+        return ok;
+    }
+
+    SvgOutput& operator<<(const char *text) {
+        buffer += text;
+        if (buffer.size() >= BUFFER_SIZE) flush();
+        return *this;
+    }
+    SvgOutput& operator<<(const std::string &text) {
+        buffer += text;
+        if (buffer.size() >= BUFFER_SIZE) flush();
+        return *this;
+    }
+    SvgOutput& operator<<(char c) {
+        buffer += c;
+        if (buffer.size() >= BUFFER_SIZE) flush();
+        return *this;
+    }
+    SvgOutput& operator<<(int number) {
+        char digits[12];
+        unsigned value = number < 0 ? 0u - number : number;
+        int pos = sizeof(digits);
+        do {
+            digits[--pos] = '0' + value % 10;
+            value /= 10;
+        } while (value > 0);
+        if (number < 0) digits[--pos] = '-';
+        buffer.append(digits + pos, sizeof(digits) - pos);
+        if (buffer.size() >= BUFFER_SIZE) flush();
+        return *this;
+    }
+    // appends text with the characters XML treats specially replaced, for
+    // anything from the world such as realm names
+    SvgOutput& escaped(const std::string &text) {
+        for (char c : text) {
+            switch (c) {
+                case '&':   buffer += "&amp;";  break;
+                case '<':   buffer += "&lt;";   break;
+                case '>':   buffer += "&gt;";   break;
+                case '"':   buffer += "&quot;"; break;
+                case '\'':  buffer += "&apos;"; break;
+                default:    buffer += c;
+            }
+        }
+        if (buffer.size() >= BUFFER_SIZE) flush();
+        return *this;
+    }
+private:
+    static const unsigned BUFFER_SIZE = 1 << 16;
+
+    void flush() {
+        if (buffer.empty()) return;
+        if (plain && fwrite(buffer.data(), buffer.size(), 1, plain) != 1) failed = true;
+        if (packed && gzwrite(packed, buffer.data(), buffer.size()) != static_cast<int>(buffer.size())) failed = true;
+        buffer.clear();
+    }
+
+    FILE *plain;
+    gzFile packed;
+    std::string buffer;
+    bool failed = false;
+};
+
+// most segments written to one path element, so viewers never have to take
+// in one enormous path
+const unsigned SVG_PATH_SEGMENTS = 4096;
+
+static std::string hexColour(const Colour &c) {
+    char text[8];
+    snprintf(text, sizeof(text), "#%02x%02x%02x", c.r & 0xFF, c.g & 0xFF, c.b & 0xFF);
+    return text;
+}
+
+// Writes realms.svg, or realms.svgz through gzip. Styles come from CSS
+// classes, each link is drawn once, and links and realm dots are merged into
+// a few paths: a link is a move and a line, a dot a round-capped zero length
+// line. With a label spacing, only the first realm in each square of that
+// many map units gets a label.
+void makeSVG(World &world, const CommandArgs &arguments, std::ostream &out) {
     const int xOffset = 6;
     const int yOffset = 2;
     const int scale = 20;
+    const bool compress = arguments.value(1) == 1;
+    const int labelSpacing = arguments.value(2);
     int maxX = world.maxX;
     int maxY = world.maxY;
     while (maxX % 5 != 0) ++maxX;
@@ -48,109 +153,135 @@ void makeSVG(World &world, const std::vector<std::string> &arguments) {
     const int mapTop = yOffset * scale;
     const int mapRight = mapWidth - xOffset * scale;
     const int mapBottom = mapHeight - yOffset * scale;
+    const int biomeCount = static_cast<int>(Biome::BiomeCount);
+    // realms with no biome get the first colour past the biome ones
+    auto biomeClass = [biomeCount](const Realm *r) {
+        int b = static_cast<int>(r->biome);
+        return b >= 0 && b < biomeCount ? b : biomeCount;
+    };
 
-    std::ofstream svgMap("realms.svg");
+    const std::string filename = compress ? "realms.svgz" : "realms.svg";
+    SvgOutput svgMap(filename, compress);
+    if (!svgMap.isOpen()) {
+        out << "Failed to open " << filename << " for writing.\n\n";
+        return;
+    }
     svgMap << "<svg version=\"1.1\"\n";
     svgMap << "\tbaseProfile=\"full\"\n";
     svgMap << "\twidth=\"" << mapWidth << "\" height=\"";
     svgMap << mapHeight << "\"\n";
-    svgMap << "\txmlns=\"http://www.w3.org/2000/svg\">\n";
+    svgMap << "\txmlns=\"http://www.w3.org/2000/svg\"\n";
+    svgMap << "\txmlns:inkscape=\"http://www.inkscape.org/namespaces/inkscape\">\n";
+
+    svgMap << "<style>\n";
+    svgMap << "\t.grid { stroke: grey; stroke-width: 1; fill: none }\n";
+    svgMap << "\t.link { stroke: orange; stroke-width: 2; fill: none }\n";
+    svgMap << "\t.dot { stroke-width: 10; stroke-linecap: round; fill: none }\n";
+    svgMap << "\ttext { font-size: smaller }\n";
+    svgMap << "\t.name { text-anchor: middle }\n";
+    svgMap << "\t.ident { dominant-baseline: hanging }\n";
+    svgMap << "\t.heading { font-weight: bold }\n";
+    for (int i = 0; i <= biomeCount; ++i) {
+        const std::string colour = hexColour(colourList[i]);
+        svgMap << "\t.b" << i << " { stroke: " << colour << "; fill: " << colour << " }\n";
+    }
+    svgMap << "</style>\n";
 
     // draw grid
     svgMap << "\t<g inkscape:label=\"Grid\" inkscape:groupmode=\"layer\" id=\"layer_grid\">\n";
-    for (int x = 0; x <= maxX; x += 5) {
-        int realX = (x + xOffset * 2) * scale;
-        if (x > 0) {
-            svgMap << "\t\t<text x=\"" << realX << "\" y=\"" << mapTop - 10;
-            svgMap << "\">" << x << "</text>\n";
-        }
-
-        svgMap << "\t\t<line x1=\"" << realX << "\" x2=\"" << realX;
-        svgMap << "\" y1=\"" << mapTop << "\" y2=\"" << mapBottom;
-        svgMap << "\" stroke=\"grey";
-        svgMap << "\" stroke-width=\"1\"/>\n";
+    for (int x = 5; x <= maxX; x += 5) {
+        svgMap << "\t\t<text x=\"" << (x + xOffset * 2) * scale << "\" y=\"" << mapTop - 10;
+        svgMap << "\">" << x << "</text>\n";
     }
     for (int y = 0; y <= maxY; y += 5) {
-        int realY = (y + yOffset) * scale;
-        svgMap << "\t<text x=\"" << mapLeft - 10 << "\" y=\"" << realY;
+        svgMap << "\t\t<text x=\"" << mapLeft - 10 << "\" y=\"" << (y + yOffset) * scale;
         svgMap << "\">" << y << "</text>\n";
-
-        svgMap << "\t<line x1=\"" << mapLeft << "\" x2=\"" << mapRight;
-        svgMap << "\" y1=\"" << realY << "\" y2=\"" << realY;
-        svgMap << "\" stroke=\"grey";
-        svgMap << "\" stroke-width=\"1\"/>\n";
     }
+    svgMap << "\t\t<path class=\"grid\" d=\"";
+    for (int x = 0; x <= maxX; x += 5) {
+        svgMap << 'M' << (x + xOffset * 2) * scale << ' ' << mapTop << 'V' << mapBottom;
+    }
+    for (int y = 0; y <= maxY; y += 5) {
+        svgMap << 'M' << mapLeft << ' ' << (y + yOffset) * scale << 'H' << mapRight;
+    }
+    svgMap << "\"/>\n";
     svgMap << "\t</g>\n";
 
-    // make link lines
+    // make link lines, each once from its lower ident end
     svgMap << "\t<g inkscape:label=\"Realm Links\" inkscape:groupmode=\"layer\" id=\"layer_realm_links\">\n";
-    for (Realm *r : world.realms) {
-        int realX = (r->x + xOffset * 2) * scale;
-        int realY = (r->y + yOffset) * scale;
-        for (const Link &l : r->links) {
-            Realm *t = world.realmByIdent(l.linkTo);
-            if (!t) continue;
-            int targetX = (t->x + xOffset * 2) * scale;
-            int targetY = (t->y + yOffset) * scale;
-            svgMap << "\t\t<line x1=\"" << realX << "\" x2=\"" << targetX;
-            svgMap << "\" y1=\"" << realY << "\" y2=\"" << targetY;
-            svgMap << "\" stroke=\"orange\" stroke-width=\"2\"/>\n";
+    const RealmGraph &graph = world.graph;
+    unsigned segments = 0;
+    for (unsigned i = 0; i < world.realms.size() && i < graph.size(); ++i) {
+        const Realm *r = world.realms[i];
+        const int realX = (r->x + xOffset * 2) * scale;
+        const int realY = (r->y + yOffset) * scale;
+        for (unsigned l = graph.firstLink[i]; l < graph.firstLink[i + 1]; ++l) {
+            const Realm *t = world.realms[graph.linkTarget[l]];
+            if (t->ident <= r->ident) continue;
+            if (segments % SVG_PATH_SEGMENTS == 0) {
+                if (segments > 0) svgMap << "\"/>\n";
+                svgMap << "\t\t<path class=\"link\" d=\"";
+            }
+            svgMap << 'M' << realX << ' ' << realY;
+            svgMap << 'L' << (t->x + xOffset * 2) * scale << ' ' << (t->y + yOffset) * scale;
+            ++segments;
         }
     }
+    if (segments > 0) svgMap << "\"/>\n";
     svgMap << "\t</g>\n";
 
+    // draw realm dots, one set of paths for each biome
     svgMap << "\t<g inkscape:label=\"Realms\" inkscape:groupmode=\"layer\" id=\"layer_realms\">\n";
-    // draw realm dots
-    for (Realm *r : world.realms) {
-        int realX = (r->x + xOffset * 2) * scale;
-        int realY = (r->y + yOffset) * scale;
-        svgMap << "\t\t<circle cx=\"" << realX << "\" cy=\"" << realY;
-        svgMap << "\" r=\"5\" ";
-        svgMap << "fill=\"#" << std::hex << std::setfill('0');
-        svgMap << std::setw(2) << colourList[static_cast<int>(r->biome)].r;
-        svgMap << std::setw(2) << colourList[static_cast<int>(r->biome)].g;
-        svgMap << std::setw(2) << colourList[static_cast<int>(r->biome)].b;
-        svgMap << "\" />\n" << std::dec;
+    std::vector<std::vector<const Realm*>> byBiome(biomeCount + 1);
+    for (const Realm *r : world.realms) byBiome[biomeClass(r)].push_back(r);
+    for (int b = 0; b <= biomeCount; ++b) {
+        for (unsigned i = 0; i < byBiome[b].size(); ++i) {
+            const Realm *r = byBiome[b][i];
+            if (i % SVG_PATH_SEGMENTS == 0) {
+                if (i > 0) svgMap << "\"/>\n";
+                svgMap << "\t\t<path class=\"dot b" << b << "\" d=\"";
+            }
+            svgMap << 'M' << (r->x + xOffset * 2) * scale << ' ' << (r->y + yOffset) * scale << "h0";
+        }
+        if (!byBiome[b].empty()) svgMap << "\"/>\n";
     }
     svgMap << "\t</g>\n";
 
+    // draw realm labels, name above and ident below
     svgMap << "\t<g inkscape:label=\"Realm Labels\" inkscape:groupmode=\"layer\" id=\"layer_realm_labels\">\n";
-    // draw realm labels
-    for (Realm *r : world.realms) {
-        int realX = (r->x + xOffset * 2) * scale;
-        int realY = (r->y + yOffset) * scale;
-        svgMap << "\t\t<text x=\"" << realX << "\" y=\"" << realY - 7;
-        svgMap << "\" text-anchor=\"middle\" font-size=\"smaller\">";
-        svgMap << r->name << "</text>\n";
-        svgMap << "\t\t<text x=\"" << realX << "\" y=\"" << realY + 7;
-        svgMap << "\" text-anchor=\"middle\" dominant-baseline=\"hanging\" font-size=\"smaller\">[";
-        svgMap << r->ident << "]</text>\n";
+    std::unordered_set<unsigned long long> labelledCells;
+    for (const Realm *r : world.realms) {
+        if (labelSpacing > 0) {
+            unsigned long long cell = static_cast<unsigned long long>(static_cast<unsigned>(r->x / labelSpacing)) << 32
+                                    | static_cast<unsigned>(r->y / labelSpacing);
+            if (!labelledCells.insert(cell).second) continue;
+        }
+        const int realX = (r->x + xOffset * 2) * scale;
+        const int realY = (r->y + yOffset) * scale;
+        svgMap << "\t\t<text class=\"name\" x=\"" << realX << "\" y=\"" << realY - 7 << "\">";
+        svgMap.escaped(r->name);
+        svgMap << "<tspan class=\"ident\" x=\"" << realX << "\" y=\"" << realY + 7 << "\">[";
+        svgMap << r->ident << "]</tspan></text>\n";
     }
     svgMap << "\t</g>\n";
 
     // draw biome legend
     svgMap << "\t<g inkscape:label=\"Legend (Biome)\" inkscape:groupmode=\"layer\" id=\"layer_biome\">\n";
-    svgMap << "\t\t<text x=\"45\" y=\"" << 20 + yOffset * scale;
-    svgMap << "\" font-size=\"smaller\" font-weight=\"bold\">";
-    svgMap << "BIOMES</text>\n";
-
-    int counter = 0;
-    for (int i = 0; i < static_cast<int>(Biome::BiomeCount); ++i) {
-        svgMap << "\t\t<rect x=\"25\" y=\"" << (28 + 20 * counter) + yOffset * scale;
-        svgMap << "\" width=\"15\" height=\"15\" fill=\"#";
-        svgMap << std::hex << std::setfill('0');
-        svgMap << std::setw(2) << colourList[i].r << std::setw(2) << colourList[i].g;
-        svgMap << std::setw(2) << colourList[i].b << "\"/>\n" << std::dec;
-
-        svgMap << "\t\t<text x=\"" << 45 << "\" y=\"" << (40 + 20 * counter) + yOffset * scale;
-        svgMap << "\" font-size=\"smaller\">";
-        svgMap << static_cast<Biome>(i) << "</text>\n";
-
-        ++counter;
+    svgMap << "\t\t<text class=\"heading\" x=\"45\" y=\"" << 20 + yOffset * scale << "\">BIOMES</text>\n";
+    for (int i = 0; i < biomeCount; ++i) {
+        std::stringstream name;
+        name << static_cast<Biome>(i);
+        svgMap << "\t\t<rect class=\"b" << i << "\" x=\"25\" y=\"" << (28 + 20 * i) + yOffset * scale;
+        svgMap << "\" width=\"15\" height=\"15\"/>\n";
+        svgMap << "\t\t<text x=\"45\" y=\"" << (40 + 20 * i) + yOffset * scale << "\">";
+        svgMap.escaped(name.str()) << "</text>\n";
     }
     svgMap << "\t</g>\n";
 
-
     svgMap << "</svg>\n";
-    std::cout << "Wrote SVG map to realms.svg\n\n";
+    if (!svgMap.close()) {
+        out << "Failed to write " << filename << ".\n\n";
+        return;
+    }
+    out << "Wrote SVG map to " << filename << "\n\n";
 }
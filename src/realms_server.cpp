@@ -0,0 +1,196 @@
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "realms.h"
+
+// Server mode: loads the world once and answers commands from any number of
+// clients over a Unix domain socket. Each connection gets its own thread and
+// sends one command per line; the reply is the command's output followed by
+// a line holding a single "." so clients know where it ends. Read-only
+// commands from different clients run side by side, anything else waits for
+// sole use of the world.
+
+
+#ifdef _WIN32
+
+int runServer(World &world, const std::string &socketPath) {
+    std::cerr << "Server mode is not supported on this platform.\n";
+    return 1;
+}
+
+#else
+
+// Many readers or a single writer. Writers are let in ahead of new readers
+// so a steady stream of queries can't hold off an export forever.
+class WorldLock {
+public:
+    void lockShared() {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this]() { return !writing && waitingWriters == 0; });
+        ++readers;
+    }
+    void unlockShared() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (--readers == 0) changed.notify_all();
+    }
+    void lockExclusive() {
+        std::unique_lock<std::mutex> guard(lock);
+        ++waitingWriters;
+        changed.wait(guard, [this]() { return !writing && readers == 0; });
+        --waitingWriters;
+        writing = true;
+    }
+    void unlockExclusive() {
+        std::lock_guard<std::mutex> guard(lock);
+        writing = false;
+        changed.notify_all();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable changed;
+    unsigned readers = 0;
+    unsigned waitingWriters = 0;
+    bool writing = false;
+};
+
+// Scoped holds on a WorldLock, released even if a command throws.
+class SharedWorldLock {
+public:
+    explicit SharedWorldLock(WorldLock &worldLock) : worldLock(worldLock) { worldLock.lockShared(); }
+    ~SharedWorldLock() { worldLock.unlockShared(); }
+    SharedWorldLock(const SharedWorldLock&) = delete;
+    SharedWorldLock& operator=(const SharedWorldLock&) = delete;
+private:
+    WorldLock &worldLock;
+};
+
+class ExclusiveWorldLock {
+public:
+    explicit ExclusiveWorldLock(WorldLock &worldLock) : worldLock(worldLock) { worldLock.lockExclusive(); }
+    ~ExclusiveWorldLock() { worldLock.unlockExclusive(); }
+    ExclusiveWorldLock(const ExclusiveWorldLock&) = delete;
+    ExclusiveWorldLock& operator=(const ExclusiveWorldLock&) = delete;
+private:
+    WorldLock &worldLock;
+};
+
+static bool sendAll(int fd, const std::string &data) {
+    const char *p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t sent = send(fd, p, left, 0);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += sent;
+        left -= sent;
+    }
+    return true;
+}
+
+// longest command line accepted; a client sending more than this without a
+// newline is told so and disconnected, rather than buffered indefinitely
+const size_t MAX_LINE_LENGTH = 64 * 1024;
+
+static void serveClient(World &world, WorldLock &worldLock, int fd) {
+    std::string pending, reply;
+    char buffer[4096];
+    bool open = true;
+
+    while (open) {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        pending.append(buffer, got);
+
+        // answer every complete line received so far with a single send
+        reply.clear();
+        size_t start = 0, end;
+        while (open && (end = pending.find('\n', start)) != std::string::npos) {
+            std::string command = pending.substr(start, end - start);
+            start = end + 1;
+            if (!command.empty() && command.back() == '\r') command.pop_back();
+
+            std::ostringstream out;
+            if (isConcurrentCommand(command)) {
+                SharedWorldLock guard(worldLock);
+                processCommand(world, command, out);
+            } else {
+                ExclusiveWorldLock guard(worldLock);
+                if (processCommand(world, command, out)) open = false;
+            }
+            reply += out.str();
+            reply += ".\n";
+        }
+        pending.erase(0, start);
+        if (open && pending.size() > MAX_LINE_LENGTH) {
+            reply += "Command line too long.\n.\n";
+            open = false;
+        }
+        if (!sendAll(fd, reply)) break;
+    }
+    // closing with unread input would reset the connection and could lose
+    // the last reply, so finish sending and discard what is already queued
+    shutdown(fd, SHUT_WR);
+    while (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) { }
+    close(fd);
+}
+
+int runServer(World &world, const std::string &socketPath) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path " << socketPath << " is too long.\n";
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Failed to create socket: " << strerror(errno) << "\n";
+        return 1;
+    }
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+            || listen(listener, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen on " << socketPath << ": " << strerror(errno) << "\n";
+        close(listener);
+        return 1;
+    }
+    // a client hanging up mid-reply shouldn't take the server down with it
+    signal(SIGPIPE, SIG_IGN);
+    std::cerr << "Listening on " << socketPath << ".\n";
+
+    WorldLock worldLock;
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "Failed to accept connection: " << strerror(errno) << "\n";
+            break;
+        }
+        std::thread(serveClient, std::ref(world), std::ref(worldLock), client).detach();
+    }
+
+    close(listener);
+    unlink(socketPath.c_str());
+    return 1;
+}
+
+#endif
@@ -3,7 +3,7 @@
 #include <iostream>
 #include "realms.h"
 
-void makeSQL(World &world, const std::vector<std::string> &arguments) {
+void makeSQL(World &world, const CommandArgs &arguments, std::ostream &out) {
     std::ofstream sqlfile("realms.sql");
 
     sqlfile << "drop table if exists realms;\n";
@@ -90,5 +90,5 @@ void makeSQL(World &world, const std::vector<std::string> &arguments) {
         }
     }
 
-    std::cout << "Wrote SQL file to realms.sql\n\n";
+    out << "Wrote SQL file to realms.sql\n\n";
 }
@@ -8,211 +8,347 @@
 #include <map>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "realms.h"
 
-void showSpeciesStats(World &world, const std::vector<std::string> &arguments) {
-    int speciesCount = world.species.size();
+// Realms above this count have their stats reduced on several threads.
+const unsigned PARALLEL_STATS_MIN = 100000;
+
+// The realm fields the stats read, copied into one array each so every
+// aggregate is a tight loop over contiguous memory.
+struct RealmColumns {
+    std::vector<int> diameter, popDensity, links, biome, faction, species;
+    std::vector<long long> population;
+};
+
+struct Extreme {
+    long long value;
+    int index;      // position in world.realms, or -1 if there were no realms
+};
+
+// Every aggregate the stats subcommands report, apart from the area and
+// population totals World already keeps. Histograms are indexed by biome,
+// faction or species ident; idents below zero are counted in the matching
+// bad* field instead.
+struct RealmStats {
+    unsigned count;
+    Extreme minDiameter, maxDiameter, minPopDensity, maxPopDensity;
+    Extreme minPopulation, maxPopulation, maxLinks;
+    long long totalDiameter, totalPopDensity, totalLinks;
+    std::vector<unsigned> biomes, factions, species;
+    unsigned badFactions, badSpecies;
+};
+
+RealmColumns gatherColumns(const World &world) {
+    RealmColumns c;
+    const unsigned n = world.realms.size();
+    c.diameter.resize(n);
+    c.popDensity.resize(n);
+    c.links.resize(n);
+    c.biome.resize(n);
+    c.faction.resize(n);
+    c.species.resize(n);
+    c.population.resize(n);
+    for (unsigned i = 0; i < n; ++i) {
+        const Realm *r = world.realms[i];
+        c.diameter[i] = r->diameter;
+        c.popDensity[i] = r->populationDensity;
+        c.links[i] = r->links.size();
+        c.biome[i] = static_cast<int>(r->biome);
+        c.faction[i] = r->faction;
+        c.species[i] = r->primarySpecies;
+        c.population[i] = r->population();
+    }
+    return c;
+}
 
-    std::map<int, int> counts;
-    std::map<Stance, int> stances;
-    std::map<Wings, int> wings;
+// Ties go to the earliest realm, so chunks must be merged in order.
+static void takeMin(Extreme &e, const Extreme &other) {
+    if (other.index >= 0 && (e.index < 0 || other.value < e.value)) e = other;
+}
+static void takeMax(Extreme &e, const Extreme &other) {
+    if (other.index >= 0 && (e.index < 0 || other.value > e.value)) e = other;
+}
 
-    int minHeight = 9999;
-    int maxHeight = 0;
-    int totalHeight = 0;
+template<class T>
+static void columnExtremes(const std::vector<T> &column, unsigned lo, unsigned hi, Extreme &min, Extreme &max) {
+    min.index = max.index = -1;
+    if (lo >= hi) return;
+    T minValue = column[lo], maxValue = column[lo];
+    unsigned minIndex = lo, maxIndex = lo;
+    for (unsigned i = lo + 1; i < hi; ++i) {
+        if (column[i] < minValue) { minValue = column[i]; minIndex = i; }
+        if (column[i] > maxValue) { maxValue = column[i]; maxIndex = i; }
+    }
+    min = Extreme{ static_cast<long long>(minValue), static_cast<int>(minIndex) };
+    max = Extreme{ static_cast<long long>(maxValue), static_cast<int>(maxIndex) };
+}
 
-    int longestName = 0;
+template<class T>
+static long long columnSum(const std::vector<T> &column, unsigned lo, unsigned hi) {
+    long long total = 0;
+    for (unsigned i = lo; i < hi; ++i) total += column[i];
+    return total;
+}
 
-    for (const Realm *r : world.realms) {
-        ++counts[r->primarySpecies];
+static void columnHistogram(const std::vector<int> &column, unsigned lo, unsigned hi,
+                            std::vector<unsigned> &histogram, unsigned &bad) {
+    for (unsigned i = lo; i < hi; ++i) {
+        int value = column[i];
+        if (value < 0) {
+            ++bad;
+            continue;
+        }
+        if (static_cast<unsigned>(value) >= histogram.size()) histogram.resize(value + 1);
+        ++histogram[value];
     }
-    for (const Species *s : world.species) {
-        if (s->name.size() > longestName) longestName = s->name.size();
-        ++stances[s->stance];
-        ++wings[s->wings];
+}
 
-        if (s->height < minHeight) minHeight = s->height;
-        if (s->height > maxHeight) maxHeight = s->height;
-        totalHeight += s->height;
-    }
+static void reduceRange(const RealmColumns &c, unsigned lo, unsigned hi, RealmStats &stats) {
+    Extreme unused;
+    stats.count = hi - lo;
+    columnExtremes(c.diameter, lo, hi, stats.minDiameter, stats.maxDiameter);
+    columnExtremes(c.popDensity, lo, hi, stats.minPopDensity, stats.maxPopDensity);
+    columnExtremes(c.population, lo, hi, stats.minPopulation, stats.maxPopulation);
+    columnExtremes(c.links, lo, hi, unused, stats.maxLinks);
+    stats.totalDiameter = columnSum(c.diameter, lo, hi);
+    stats.totalPopDensity = columnSum(c.popDensity, lo, hi);
+    stats.totalLinks = columnSum(c.links, lo, hi);
+    stats.biomes.assign(static_cast<int>(Biome::BiomeCount), 0);
+    stats.factions.clear();
+    stats.species.clear();
+    stats.badFactions = stats.badSpecies = 0;
+    unsigned badBiomes = 0;
+    columnHistogram(c.biome, lo, hi, stats.biomes, badBiomes);
+    columnHistogram(c.faction, lo, hi, stats.factions, stats.badFactions);
+    columnHistogram(c.species, lo, hi, stats.species, stats.badSpecies);
+}
 
-    std::cout << std::left << std::setw(longestName) << "Name" << "  Count\n";
-    for (int i = 0; i < longestName; ++i) std::cout << '-';
-    std::cout << "-------\n";
-    for (auto iter : counts) {
-        std::cout << std::setw(longestName);
-        const Species *s = world.speciesByIdent(iter.first);
-        if (s)  std::cout << s->name;
-        else    std::cout << "(bad ident)";
-        std::cout << "  " << iter.second << "\n";
-    }
-    std::cout << "\n\n";
-
-    std::cout << "Biped: " << stances[Stance::Biped]  << " (" << percent(stances[Stance::Biped], speciesCount) << "%)\n";
-    std::cout << "Taur:  " << stances[Stance::Taur]   << " (" << percent(stances[Stance::Taur],  speciesCount) << "%)\n";
-    std::cout << "Quad:  " << stances[Stance::Quad]   << " (" << percent(stances[Stance::Quad],  speciesCount) << "%)\n";
-    std::cout << "Thero: " << stances[Stance::Thero]  << " (" << percent(stances[Stance::Thero], speciesCount) << "%)\n";
-    std::cout << '\n';
-    std::cout << "No Wings: " << wings[Wings::None]   << " (" << percent(wings[Wings::None],     speciesCount) << "%)\n";
-    std::cout << "Back Wings: " << wings[Wings::Back] << " (" << percent(wings[Wings::Back],     speciesCount) << "%)\n";
-    std::cout << "Arm Wings: " << wings[Wings::Arm]   << " (" << percent(wings[Wings::Arm],      speciesCount) << "%)\n";
-    std::cout << '\n';
-    std::cout << "Max Height: " << maxHeight << " cm\n";
-    std::cout << "Min Height: " << minHeight << " cm\n";
-    std::cout << "Average Height: " << (totalHeight / speciesCount) << " cm\n";
-    std::cout << '\n';
+static void mergeHistogram(std::vector<unsigned> &into, const std::vector<unsigned> &from) {
+    if (from.size() > into.size()) into.resize(from.size());
+    for (unsigned i = 0; i < from.size(); ++i) into[i] += from[i];
 }
 
-void showRealmStats(World &world, const std::vector<std::string> &arguments) {
-    int realmCount = world.realms.size();
+static void mergeStats(RealmStats &into, const RealmStats &from) {
+    into.count += from.count;
+    takeMin(into.minDiameter, from.minDiameter);
+    takeMax(into.maxDiameter, from.maxDiameter);
+    takeMin(into.minPopDensity, from.minPopDensity);
+    takeMax(into.maxPopDensity, from.maxPopDensity);
+    takeMin(into.minPopulation, from.minPopulation);
+    takeMax(into.maxPopulation, from.maxPopulation);
+    takeMax(into.maxLinks, from.maxLinks);
+    into.totalDiameter += from.totalDiameter;
+    into.totalPopDensity += from.totalPopDensity;
+    into.totalLinks += from.totalLinks;
+    mergeHistogram(into.biomes, from.biomes);
+    mergeHistogram(into.factions, from.factions);
+    mergeHistogram(into.species, from.species);
+    into.badFactions += from.badFactions;
+    into.badSpecies += from.badSpecies;
+}
 
-    std::map<Biome, int> biomes;
+// Computes every realm aggregate at once. Large worlds are split into one
+// chunk per hardware thread and the partial results merged in order.
+RealmStats computeRealmStats(const World &world) {
+    RealmColumns columns = gatherColumns(world);
+    const unsigned n = world.realms.size();
+    unsigned chunks = 1;
+    if (n >= PARALLEL_STATS_MIN) chunks = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<RealmStats> partial(chunks);
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < chunks; ++i) {
+        threads.push_back(std::thread(reduceRange, std::cref(columns),
+                                      n * i / chunks, n * (i + 1) / chunks, std::ref(partial[i])));
+    }
+    reduceRange(columns, 0, n / chunks, partial[0]);
+    for (std::thread &t : threads) t.join();
 
-    int maxDiameter = 0, maxDiameterId = -1;
-    int minDiameter = 999999, minDiameterId = -1;
-    int totalDiameter = 0;
-    unsigned long long totalArea = 0;
+    for (unsigned i = 1; i < chunks; ++i) mergeStats(partial[0], partial[i]);
+    return partial[0];
+}
 
-    int maxPopDensity = 0, maxPopDensityId = -1;
-    int minPopDensity = 999999, minPopDensityId = -1;
-    int totalPopDensity = 0;
+static void showExtreme(const World &world, const Extreme &e, std::ostream &out) {
+    if (e.index < 0) return;
+    const Realm *r = world.realms[e.index];
+    out << " (" << r->name << " [" << r->ident << "])";
+}
 
-    int maxPopulation = 0, maxPopulationId = -1;
-    int minPopulation = 999999999, minPopulationId = -1;
 
-    unsigned long totalPopulation = 0;
+void showSpeciesStats(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int speciesCount = world.species.size();
+    RealmStats stats = computeRealmStats(world);
 
-    unsigned maxLinks = 0, maxLinksId = -1;
-    int totalLinks = 0;
+    int stances[static_cast<int>(Stance::Count)] = { 0 };
+    int wings[static_cast<int>(Wings::Count)] = { 0 };
 
-    for (const Realm *r : world.realms) {
-        ++biomes[r->biome];
+    int minHeight = 9999;
+    int maxHeight = 0;
+    int totalHeight = 0;
 
-        if (r->links.size() > maxLinks) { maxLinks = r->links.size(); maxLinksId = r->ident; }
-        totalLinks += r->links.size();
+    unsigned longestName = 0;
+    // the histogram is indexed by ident; the first species with an ident wins
+    std::vector<const Species*> byIdent(stats.species.size(), nullptr);
 
-        if (r->diameter > maxDiameter) { maxDiameter = r->diameter; maxDiameterId = r->ident; }
-        if (r->diameter < minDiameter) { minDiameter = r->diameter; minDiameterId = r->ident; }
-        totalDiameter += r->diameter;
-        totalArea += r->area();
+    for (const Species *s : world.species) {
+        if (s->ident >= 0 && static_cast<unsigned>(s->ident) < byIdent.size() && !byIdent[s->ident]) {
+            byIdent[s->ident] = s;
+        }
+        if (s->name.size() > longestName) longestName = s->name.size();
+        ++stances[static_cast<int>(s->stance)];
+        ++wings[static_cast<int>(s->wings)];
 
-        if (r->populationDensity > maxPopDensity) { maxPopDensity = r->populationDensity; maxPopDensityId = r->ident; }
-        if (r->populationDensity < minPopDensity) { minPopDensity = r->populationDensity; minPopDensityId = r->ident; }
-        totalPopulation += r->population();
+        if (s->height < minHeight) minHeight = s->height;
+        if (s->height > maxHeight) maxHeight = s->height;
+        totalHeight += s->height;
+    }
 
-        if (r->population() > maxPopulation) { maxPopulation = r->population(); maxPopulationId = r->ident; }
-        if (r->population() < minPopulation) { minPopulation = r->population(); minPopulationId = r->ident; }
-        totalPopDensity += r->populationDensity;
+    out << std::left << std::setw(longestName) << "Name" << "  Count\n";
+    for (unsigned i = 0; i < longestName; ++i) out << '-';
+    out << "-------\n";
+    if (stats.badSpecies > 0) {
+        out << std::setw(longestName) << "(bad ident)" << "  " << stats.badSpecies << "\n";
     }
+    for (unsigned i = 0; i < stats.species.size(); ++i) {
+        if (stats.species[i] == 0) continue;
+        out << std::setw(longestName);
+        const Species *s = byIdent[i];
+        if (s)  out << s->name;
+        else    out << "(bad ident)";
+        out << "  " << stats.species[i] << "\n";
+    }
+    out << "\n\n";
+
+    int biped = stances[static_cast<int>(Stance::Biped)];
+    int taur = stances[static_cast<int>(Stance::Taur)];
+    int quad = stances[static_cast<int>(Stance::Quad)];
+    int thero = stances[static_cast<int>(Stance::Thero)];
+    int noWings = wings[static_cast<int>(Wings::None)];
+    int backWings = wings[static_cast<int>(Wings::Back)];
+    int armWings = wings[static_cast<int>(Wings::Arm)];
+    out << "Biped: " << biped  << " (" << percent(biped, speciesCount) << "%)\n";
+    out << "Taur:  " << taur   << " (" << percent(taur,  speciesCount) << "%)\n";
+    out << "Quad:  " << quad   << " (" << percent(quad,  speciesCount) << "%)\n";
+    out << "Thero: " << thero  << " (" << percent(thero, speciesCount) << "%)\n";
+    out << '\n';
+    out << "No Wings: " << noWings     << " (" << percent(noWings,   speciesCount) << "%)\n";
+    out << "Back Wings: " << backWings << " (" << percent(backWings, speciesCount) << "%)\n";
+    out << "Arm Wings: " << armWings   << " (" << percent(armWings,  speciesCount) << "%)\n";
+    out << '\n';
+    out << "Max Height: " << maxHeight << " cm\n";
+    out << "Min Height: " << minHeight << " cm\n";
+    out << "Average Height: " << (totalHeight / speciesCount) << " cm\n";
+    out << '\n';
+}
+
+void showRealmStats(World &world, const CommandArgs &arguments, std::ostream &out) {
+    int realmCount = world.realms.size();
+    RealmStats stats = computeRealmStats(world);
 
-    std::cout << '\n';
-    std::cout << "Biome         #      %\n";
-    std::cout << "-----------------------\n";
+    out << '\n';
+    out << "Biome         #      %\n";
+    out << "-----------------------\n";
     for (int i = 0; i < static_cast<int>(Biome::BiomeCount); ++i) {
         Biome b = static_cast<Biome>(i);
-        std::cout << std::setw(10) << std::left << b << "   " << std::right;
-        std::cout << std::setw(2) << biomes[b] << "   " << std::setw(3) << percent(biomes[b], realmCount) << "%\n";
+        out << std::setw(10) << std::left << b << "   " << std::right;
+        out << std::setw(2) << stats.biomes[i] << "   " << std::setw(3) << percent(stats.biomes[i], realmCount) << "%\n";
     }
 
-    std::cout << "\nMost Links: " << maxLinks;
-    if (maxLinksId >= 0) std::cout << " (" << world.realmByIdent(maxLinksId)->name << " [" << maxLinksId << "])";
-    std::cout << '\n';
-    std::cout << "Average Links: " << totalLinks / realmCount << "\n";
-
-    std::cout << "\nLargest Diameter: " << maxDiameter << " km [area: " << intToString(calcArea(maxDiameter/2.0)) << " sq.km]";
-    if (maxDiameterId >= 0) std::cout << " (" << world.realmByIdent(maxDiameterId)->name << " [" << maxDiameterId << "])";
-    std::cout << '\n';
-    std::cout << "Average Diameter: " << (totalDiameter / realmCount) << " km [area: " << intToString(calcArea((totalDiameter/realmCount)/2.0)) << " sq.km]\n";
-    std::cout << "Smallest Diameter: " << minDiameter << " km [area: " << intToString(calcArea(minDiameter/2.0)) << " sq.km]";
-    if (minDiameterId >= 0) std::cout << " (" << world.realmByIdent(minDiameterId)->name << " [" << minDiameterId << "])";
-    std::cout << '\n';
-
-    std::cout << "\nLargest Population: " << intToString(maxPopulation);
-    if (maxPopulationId >= 0) std::cout << " (" << world.realmByIdent(maxPopulationId)->name << " [" << maxPopulationId << "])";
-    std::cout << '\n';
-    std::cout << "Average Population: " << intToString(totalPopulation / realmCount) << "\n";
-    std::cout << "Smallest Population: " << intToString(minPopulation);
-    if (minPopulationId >= 0) std::cout << " (" << world.realmByIdent(minPopulationId)->name << " [" << minPopulationId << "])";
-    std::cout << '\n';
-
-    std::cout << "\nLargest Pop. Density: " << maxPopDensity;
-    if (maxPopDensityId >= 0) std::cout << " (" << world.realmByIdent(maxPopDensityId)->name << " [" << maxPopDensityId << "])";
-    std::cout << '\n';
-    std::cout << "Average Pop. Density: " << (totalPopDensity / realmCount) << "\n";
-    std::cout << "Smallest Pop. Density: " << minPopDensity;
-    if (minPopDensityId >= 0) std::cout << " (" << world.realmByIdent(minPopDensityId)->name << " [" << minPopDensityId << "])";
-    std::cout << "\n\n";
-
-    std::cout << "Total Realms: " << world.realms.size() << "\n";
-    std::cout << "Total Area: " << intToString(totalArea) << " sq.km\n";
-    std::cout << "Total Population: " << intToString(totalPopulation) << "\n";
+    out << "\nMost Links: " << (stats.maxLinks.index >= 0 ? stats.maxLinks.value : 0);
+    showExtreme(world, stats.maxLinks, out);
+    out << '\n';
+    out << "Average Links: " << stats.totalLinks / realmCount << "\n";
+
+    int averageDiameter = stats.totalDiameter / realmCount;
+    out << "\nLargest Diameter: " << stats.maxDiameter.value << " km [area: " << intToString(calcArea(stats.maxDiameter.value/2.0)) << " sq.km]";
+    showExtreme(world, stats.maxDiameter, out);
+    out << '\n';
+    out << "Average Diameter: " << averageDiameter << " km [area: " << intToString(calcArea(averageDiameter/2.0)) << " sq.km]\n";
+    out << "Smallest Diameter: " << stats.minDiameter.value << " km [area: " << intToString(calcArea(stats.minDiameter.value/2.0)) << " sq.km]";
+    showExtreme(world, stats.minDiameter, out);
+    out << '\n';
+
+    out << "\nLargest Population: " << intToString(stats.maxPopulation.value);
+    showExtreme(world, stats.maxPopulation, out);
+    out << '\n';
+    out << "Average Population: " << intToString(world.totalPopulation / realmCount) << "\n";
+    out << "Smallest Population: " << intToString(stats.minPopulation.value);
+    showExtreme(world, stats.minPopulation, out);
+    out << '\n';
+
+    out << "\nLargest Pop. Density: " << stats.maxPopDensity.value;
+    showExtreme(world, stats.maxPopDensity, out);
+    out << '\n';
+    out << "Average Pop. Density: " << (stats.totalPopDensity / realmCount) << "\n";
+    out << "Smallest Pop. Density: " << stats.minPopDensity.value;
+    showExtreme(world, stats.minPopDensity, out);
+    out << "\n\n";
+
+    out << "Total Realms: " << world.realms.size() << "\n";
+    out << "Total Area: " << intToString(world.totalArea) << " sq.km\n";
+    out << "Total Population: " << intToString(world.totalPopulation) << "\n";
 }
 
-void showFactionStats(World &world, const std::vector<std::string> &arguments) {
+void showFactionStats(World &world, const CommandArgs &arguments, std::ostream &out) {
     int realmCount = world.realms.size();
+    RealmStats stats = computeRealmStats(world);
 
-    std::map<unsigned, int> counts;
-    for (const Realm *r : world.realms) {
-        ++counts[r->faction];
-    }
-    for (auto iter : counts) {
-        if (iter.first < 0 || iter.first >= world.factions.size()) {
-            std::cout << "BADFACTION  ";
+    for (unsigned i = 0; i < stats.factions.size(); ++i) {
+        if (stats.factions[i] == 0) continue;
+        if (i >= world.factions.size()) {
+            out << "BADFACTION  ";
         } else  {
-            std::cout << std::setw(12) << world.factions[iter.first]->name;
+            out << std::setw(12) << world.factions[i]->name;
         }
-        std::cout << " [" << iter.first << "]: " << iter.second;
-        std::cout << " (" << percent(iter.second, realmCount) << "%)\n";
+        out << " [" << i << "]: " << stats.factions[i];
+        out << " (" << percent(stats.factions[i], realmCount) << "%)\n";
+    }
+    if (stats.badFactions > 0) {
+        out << "BADFACTION   [-1]: " << stats.badFactions;
+        out << " (" << percent(stats.badFactions, realmCount) << "%)\n";
     }
 
-    std::cout << "\n    |";
+    out << "\n    |";
     for (const Faction *o : world.factions) {
         if (o->ident == 0) continue;
-        std::cout << ' ' << std::setw(3) << o->ident;
+        out << ' ' << std::setw(3) << o->ident;
     }
-    std::cout << "\n";
-    std::cout << "----+";
+    out << "\n";
+    out << "----+";
     for (const Faction *o : world.factions) {
         if (o->ident == 0) continue;
-        std::cout << "----";
+        out << "----";
     }
-    std::cout << "\n";
+    out << "\n";
+    // one search per faction home gives the whole row of distances
+    SearchScratch scratch;
     for (const Faction *o : world.factions) {
         if (o->ident == 0) continue;
-        std::cout << std::setw(3) << o->ident << " |";
+        out << std::setw(3) << o->ident << " |";
+        world.distancesFrom(o->home, scratch);
         for (const Faction *i : world.factions) {
             if (i->ident == 0) continue;
             if (o == i) {
-                std::cout << "  --";
+                out << "  --";
             } else {
-                int dist = world.findDistance(o->home, i->home);
-                std::cout << ' ' << std::setw(3) << dist;
+                int home = world.graph.indexOf(i->home);
+                int dist = home < 0 || scratch.distance.empty() ? -1 : scratch.distance[home];
+                out << ' ' << std::setw(3) << dist;
             }
         }
-        std::cout << "\n";
+        out << "\n";
     }
-    std::cout << '\n';
+    out << '\n';
 }
 
-void statsDispatcher(World &world, const std::vector<std::string> &arguments) {
-    if (arguments.size() == 2) {
-        if (arguments[1] == "species") {
-            showSpeciesStats(world, arguments);
-            return;
-        }
-
-        if (arguments[1] == "realm") {
-            showRealmStats(world, arguments);
-            return;
-        }
-
-        if (arguments[1] == "faction") {
-            showFactionStats(world, arguments);
-            return;
-        }
+void statsDispatcher(World &world, const CommandArgs &arguments, std::ostream &out) {
+    // the choices are declared as faction|realm|species
+    switch (arguments.value(1)) {
+        case 0: showFactionStats(world, arguments, out); break;
+        case 1: showRealmStats(world, arguments, out);   break;
+        case 2: showSpeciesStats(world, arguments, out); break;
     }
-
-    std::cout << "Must specify 'faction', 'realm', or 'species'.\n\n";
 }
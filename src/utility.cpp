@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <ctime>
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <unordered_set>
 #include <vector>
 
 
@@ -116,5 +119,45 @@ void rngInit(int seed) {
 }
 
 int rngNext(int max) {
+    // combine two draws when rand() alone cannot cover the range
+    if (max > RAND_MAX) {
+        long long wide = static_cast<long long>(rand()) * (RAND_MAX + 1LL) + rand();
+        return wide % max;
+    }
     return rand() % max;
 }
+
+// Picks count distinct indices below population, uniformly at random. Small
+// samples use Floyd's algorithm, which needs only the sample itself; large
+// ones shuffle the front of an index array (a partial Fisher-Yates). Either
+// way the order of the result is random too.
+std::vector<unsigned> rngSample(unsigned population, unsigned count) {
+    std::vector<unsigned> sample;
+    if (count > population) count = population;
+    sample.reserve(count);
+
+    if (count < population / 4) {
+        std::unordered_set<unsigned> chosen;
+        chosen.reserve(count * 2);
+        for (unsigned j = population - count; j < population; ++j) {
+            unsigned pick = rngNext(j + 1);
+            if (!chosen.insert(pick).second) {
+                pick = j;
+                chosen.insert(pick);
+            }
+            sample.push_back(pick);
+        }
+        // Floyd's picks come out in a biased order, so shuffle them
+        for (unsigned i = count; i > 1; --i) std::swap(sample[i - 1], sample[rngNext(i)]);
+        return sample;
+    }
+
+    std::vector<unsigned> indices(population);
+    for (unsigned i = 0; i < population; ++i) indices[i] = i;
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned pick = i + rngNext(population - i);
+        std::swap(indices[i], indices[pick]);
+        sample.push_back(indices[i]);
+    }
+    return sample;
+}
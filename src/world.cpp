@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <fstream>
 #include <string>
@@ -10,12 +11,14 @@
 
 #include "realms.h"
 
-int Realm::area() const {
-    return calcArea(diameter / 2.0);
+unsigned long World::newRevision() {
+    static std::atomic<unsigned long> lastRevision(0);
+    return ++lastRevision;
 }
 
-int Realm::population() const {
-    return area() * populationDensity;
+void Realm::updateMetrics() {
+    cachedArea = calcArea(diameter / 2.0);
+    cachedPopulation = cachedArea * populationDensity;
 }
 
 bool Realm::hasLink(int to) {
@@ -45,6 +48,32 @@ const Link& Realm::getLink(int to) {
 }
 
 
+void RealmGraph::build(const std::vector<Realm*> &realms) {
+    identIndex.clear();
+    identIndex.reserve(realms.size());
+    for (unsigned i = 0; i < realms.size(); ++i) {
+        identIndex[realms[i]->ident] = i;
+    }
+
+    firstLink.assign(1, 0);
+    firstLink.reserve(realms.size() + 1);
+    linkTarget.clear();
+    for (const Realm *r : realms) {
+        for (const Link &l : r->links) {
+            int target = indexOf(l.linkTo);
+            if (target >= 0) linkTarget.push_back(target);
+        }
+        firstLink.push_back(linkTarget.size());
+    }
+}
+
+int RealmGraph::indexOf(int ident) const {
+    auto iter = identIndex.find(ident);
+    if (iter == identIndex.end()) return -1;
+    return iter->second;
+}
+
+
 bool World::writeToFile(const std::string &filename) const {
     std::ofstream realmList(filename);
     if (!realmList) return false;
@@ -189,6 +218,10 @@ bool World::readFromFile(const std::string &filename) {
     realms = newRealms;
     factions = newFactions;
     species = newSpecies;
+    rebuildGraph();
+    rebuildPositions();
+    updateMetrics();
+    markChanged();
     return true;
 }
 
@@ -248,40 +281,99 @@ Species* World::speciesByIdent(int ident) {
 }
 
 std::vector<int> World::findPath(int from, int to) {
-    for (Realm *r : realms) {
-        r->work2 = false;
-    }
+    SearchScratch scratch;
+    return findPath(from, to, scratch);
+}
 
+// Walks from the start realm down the distance field of a search from the
+// destination, taking the first link that gets one transit closer.
+std::vector<int> World::findPath(int from, int to, SearchScratch &scratch) const {
     std::vector<int> path;
-    setDistances(to);
-    int cur = from;
-    while (cur != to) {
-        path.push_back(cur);
-        Realm *r = realmByIdent(cur);
-        r->work2 = true;
-        int lowest = -1;
-        int lowestDist = 9999;
-        for (const Link &l : r->links) {
-            Realm *t = realmByIdent(l.linkTo);
-            if (!t) return path;
-            if (t->work2) continue;
-            if (t->work1 < lowestDist) {
-                lowestDist = t->work1;
-                lowest = t->ident;
+    int start = graph.indexOf(from);
+    if (start < 0) return path;
+    distancesFrom(to, scratch, from);
+    if (scratch.distance[start] < 0) return path;
+
+    unsigned cur = start;
+    path.push_back(from);
+    while (scratch.distance[cur] > 0) {
+        for (unsigned i = graph.firstLink[cur]; i < graph.firstLink[cur + 1]; ++i) {
+            unsigned t = graph.linkTarget[i];
+            if (scratch.distance[t] == scratch.distance[cur] - 1) {
+                cur = t;
+                break;
             }
         }
-        if (lowest < 0) return path;
-        cur = lowest;
+        path.push_back(realms[cur]->ident);
     }
-    path.push_back(to);
     return path;
 }
 
 int World::findDistance(int from, int to) {
-    Realm *r = realmByIdent(to);
-    if (!r) return -1;
-    setDistances(from);
-    return r->work1;
+    SearchScratch scratch;
+    return findDistance(from, to, scratch);
+}
+
+int World::findDistance(int from, int to, SearchScratch &scratch) const {
+    int target = graph.indexOf(to);
+    if (target < 0) return -1;
+    distancesFrom(from, scratch, to);
+    return scratch.distance[target];
+}
+
+// Breadth-first search from ident that stops maxHops transits out, so its
+// cost depends only on the size of the neighbourhood. Returns the realms
+// found, other than ident itself, in order of increasing hops.
+std::vector<RealmHops> World::realmsWithin(int ident, int maxHops, SearchScratch &scratch) const {
+    std::vector<RealmHops> found;
+    int start = graph.indexOf(ident);
+    if (start < 0) return found;
+    if (scratch.hops.size() != graph.size()) scratch.hops.assign(graph.size(), -1);
+
+    std::vector<unsigned> &queue = scratch.queue;
+    queue.clear();
+    queue.push_back(start);
+    scratch.hops[start] = 0;
+    for (unsigned head = 0; head < queue.size(); ++head) {
+        unsigned c = queue[head];
+        int hops = scratch.hops[c];
+        if (hops > 0) found.push_back(RealmHops(realms[c], hops));
+        if (hops == maxHops) continue;
+        for (unsigned i = graph.firstLink[c]; i < graph.firstLink[c + 1]; ++i) {
+            unsigned t = graph.linkTarget[i];
+            if (scratch.hops[t] >= 0) continue;
+            scratch.hops[t] = hops + 1;
+            queue.push_back(t);
+        }
+    }
+
+    for (unsigned c : queue) scratch.hops[c] = -1;
+    return found;
+}
+
+// Breadth first search over World::graph. Afterwards scratch.distance holds
+// the transits from the start to each realm by position, or -1 if it was not
+// reached. Stops early once the realm stopAt has been reached, which leaves
+// farther realms at -1.
+void World::distancesFrom(int ident, SearchScratch &scratch, int stopAt) const {
+    scratch.distance.assign(graph.size(), -1);
+    scratch.queue.clear();
+    int start = graph.indexOf(ident);
+    if (start < 0) return;
+    int stop = graph.indexOf(stopAt);
+
+    scratch.distance[start] = 0;
+    scratch.queue.push_back(start);
+    for (unsigned head = 0; head < scratch.queue.size(); ++head) {
+        unsigned c = scratch.queue[head];
+        if (static_cast<int>(c) == stop) return;
+        for (unsigned i = graph.firstLink[c]; i < graph.firstLink[c + 1]; ++i) {
+            unsigned t = graph.linkTarget[i];
+            if (scratch.distance[t] >= 0) continue;
+            scratch.distance[t] = scratch.distance[c] + 1;
+            scratch.queue.push_back(t);
+        }
+    }
 }
 
 
@@ -323,6 +415,35 @@ int World::factionSize(int ident) const {
     return count;
 }
 
+void World::rebuildGraph() {
+    graph.build(realms);
+}
+void World::rebuildPositions() {
+    positions.build(realms);
+}
+// Recomputes every realm's derived metrics and the world totals; needed
+// after realms are loaded or generated.
+void World::updateMetrics() {
+    totalArea = totalPopulation = 0;
+    for (Realm *r : realms) {
+        r->updateMetrics();
+        totalArea += r->area();
+        totalPopulation += r->population();
+    }
+}
+// Changes a realm's size and density, adjusting the world totals by the
+// difference rather than summing every realm again.
+void World::resizeRealm(Realm *realm, int diameter, int populationDensity) {
+    totalArea -= realm->area();
+    totalPopulation -= realm->population();
+    realm->diameter = diameter;
+    realm->populationDensity = populationDensity;
+    realm->updateMetrics();
+    totalArea += realm->area();
+    totalPopulation += realm->population();
+    markChanged();
+}
+
 
 std::ostream& operator<<(std::ostream &out, const Biome &biome) {
     switch(biome) {
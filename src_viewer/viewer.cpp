@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <string>
 #include <iostream>
+#include <thread>
+#include <unordered_map>
 
 #include <SDL.h>
 
@@ -10,20 +14,92 @@
 void innerMain(RenderInfo &r);
 void realm_list(World &world, RenderInfo &r, Realm *startingRealm);
 void species_list(World &world, RenderInfo &r, Species *startingSpecies);
+int runHeadless(unsigned frames, int width, int height, const std::string &dumpDir);
+int runExport(const std::string &filename, Mode mode, int scale, int threads);
+int runTileExport(const std::string &directory, bool png, Mode mode, int maxZoom, int threads);
 
 int main(int argc, char *argv[]) {
     bool wantFullscreen = false;
     bool wantMaximized = false;
     bool wantVsync = true;
+    int frameRate = 0;
+    int headlessFrames = 0;
+    int headlessWidth = 1280, headlessHeight = 720;
+    std::string dumpDir;
+    std::string exportFile;
+    std::string tileDir;
+    bool tilePng = true;
+    int tileZoom = -1;
+    Mode exportMode = Mode::Faction;
+    int exportScale = 4;
+    int exportThreads = std::max(1u, std::thread::hardware_concurrency());
 
     for (int i = 1; i < argc; ++i) {
         const std::string &arg = argv[i];
-        if (arg == "-fullscreen")           wantFullscreen = true;
-        else if (arg == "-no-fullscreen")   wantFullscreen = true;
+        if (arg == "-h" || arg == "-help" || arg == "--help") {
+            std::cerr << "Usage: viewer [options]\n"
+                         "  -fullscreen, -maximized, -vsync (and -no- forms)\n"
+                         "  -fps N               limit the frame rate\n"
+                         "  -headless N          draw N frames without a window\n"
+                         "  -size WxH            headless frame size\n"
+                         "  -dump DIR            write headless frames to DIR\n"
+                         "  -export FILE         write the whole map to FILE\n"
+                         "  -scale N             pixels per map space for -export\n"
+                         "  -tiles DIR           write a zoomable tile pyramid to DIR; every tile\n"
+                         "                       is redrawn, only tiles whose pixels changed are written\n"
+                         "  -zoom N              deepest tile zoom level\n"
+                         "  -format png|bmp      tile image format\n"
+                         "  -colour faction|species|biome\n"
+                         "  -threads N           render threads for -export and -tiles\n";
+            return 0;
+        }
+        else if (arg == "-fullscreen")      wantFullscreen = true;
+        else if (arg == "-no-fullscreen")   wantFullscreen = false;
         else if (arg == "-maximized")       wantMaximized = true;
-        else if (arg == "-no-maximized")    wantMaximized = true;
+        else if (arg == "-no-maximized")    wantMaximized = false;
         else if (arg == "-vsync")           wantVsync = true;
-        else if (arg == "-no-vsync")        wantVsync = true;
+        else if (arg == "-no-vsync")        wantVsync = false;
+        else if (arg == "-fps" && i + 1 < argc) {
+            frameRate = strToInt(argv[++i]);
+            if (frameRate < 0) frameRate = 0;
+        }
+        else if (arg == "-headless" && i + 1 < argc) headlessFrames = strToInt(argv[++i]);
+        else if (arg == "-dump" && i + 1 < argc)     dumpDir = argv[++i];
+        else if (arg == "-export" && i + 1 < argc)   exportFile = argv[++i];
+        else if (arg == "-tiles" && i + 1 < argc)    tileDir = argv[++i];
+        else if (arg == "-zoom" && i + 1 < argc)     tileZoom = std::max(0, strToInt(argv[++i]));
+        else if (arg == "-format" && i + 1 < argc) {
+            const std::string format = argv[++i];
+            if (format == "png")        tilePng = true;
+            else if (format == "bmp")   tilePng = false;
+            else std::cerr << "Unknown tile format \"" << format << "\".\n";
+        }
+        else if (arg == "-scale" && i + 1 < argc)    exportScale = std::max(1, strToInt(argv[++i]));
+        else if (arg == "-threads" && i + 1 < argc)  exportThreads = std::max(1, strToInt(argv[++i]));
+        else if (arg == "-colour" && i + 1 < argc) {
+            const std::string mode = argv[++i];
+            if (mode == "faction")      exportMode = Mode::Faction;
+            else if (mode == "species") exportMode = Mode::Species;
+            else if (mode == "biome")   exportMode = Mode::Biome;
+            else std::cerr << "Unknown colour mode \"" << mode << "\".\n";
+        }
+        else if (arg == "-size" && i + 1 < argc) {
+            std::vector<std::string> size = explode(argv[++i], 'x');
+            if (size.size() == 2) {
+                headlessWidth = std::max(400, strToInt(size[0]));
+                headlessHeight = std::max(200, strToInt(size[1]));
+            }
+        }
+    }
+
+    if (!tileDir.empty()) {
+        return runTileExport(tileDir, tilePng, exportMode, tileZoom, exportThreads);
+    }
+    if (!exportFile.empty()) {
+        return runExport(exportFile, exportMode, exportScale, exportThreads);
+    }
+    if (headlessFrames > 0) {
+        return runHeadless(headlessFrames, headlessWidth, headlessHeight, dumpDir);
     }
 
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0){
@@ -77,6 +153,7 @@ int main(int argc, char *argv[]) {
     rInfo.fontWidth = 9;
     rInfo.fontHeight = 18;
     rInfo.font = rInfo.loadTexture("gfx/font.bmp");
+    rInfo.frameRate = frameRate;
 
     innerMain(rInfo);
 
@@ -87,36 +164,105 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-enum class Mode { Faction, Species, Realm };
 enum class Task { None, Move };
 
-void buildRealmList(UIList *list, World &world) {
-    list->items.clear();
-    for (unsigned i = 0; i < world.realms.size(); ++i) {
-        const Realm *rlm = world.realms[i];
-        std::stringstream line;
-        line << rlm->name << " [" + std::to_string(rlm->ident) << "]";
-        list->items.push_back(ListRow{line.str(), rlm->ident});
-    }
+std::string formatRow(const Realm *rlm) {
+    std::stringstream line;
+    line << rlm->name << " [" + std::to_string(rlm->ident) << "]";
+    return line.str();
+}
+std::string formatRow(const Species *spc) {
+    std::stringstream line;
+    line << "\x1" << static_cast<char>(spc->r) << static_cast<char>(spc->g) << static_cast<char>(spc->b);
+    line << ' ' << spc->name << " [" + std::to_string(spc->ident) << "]";
+    return line.str();
 }
-void buildSpeciesList(UIList *list, World &world) {
-    list->items.clear();
-    for (unsigned i = 0; i < world.species.size(); ++i) {
-        const Species *spc = world.species[i];
-        std::stringstream line;
-        line << "\x1" << static_cast<char>(spc->r) << static_cast<char>(spc->g) << static_cast<char>(spc->b);
-        line << ' ' << spc->name << " [" + std::to_string(spc->ident) << "]";
-        list->items.push_back(ListRow{line.str(), spc->ident});
+std::string formatRow(const Faction *fac) {
+    std::stringstream line;
+    line << "\x1" << static_cast<char>(fac->r) << static_cast<char>(fac->g) << static_cast<char>(fac->b);
+    line << ' ' << fac->name << " [" << std::to_string(fac->ident) << "]";
+    return line.str();
+}
+
+// Lists one of the world's realm, species or faction vectors in its own
+// order. The ident lookup is built the first time it is needed and again
+// after the world changes.
+template<class T>
+class WorldListModel : public ListModel {
+public:
+    WorldListModel(const World &world, const std::vector<T*> &items)
+    : mWorld(world), mItems(items), mIndexVersion(-1)
+    { }
+
+    virtual unsigned size() const override { return mItems.size(); }
+    virtual int identAt(unsigned row) const override { return mItems[row]->ident; }
+    virtual std::string textAt(unsigned row) const override { return formatRow(mItems[row]); }
+    virtual unsigned long version() const override { return mWorld.revision; }
+
+    virtual int rowOf(int ident) override {
+        if (mIndexVersion != version() || mRows.size() != mItems.size()) {
+            mRows.clear();
+            mRows.reserve(mItems.size());
+            for (unsigned i = 0; i < mItems.size(); ++i) mRows.insert(std::make_pair(mItems[i]->ident, i));
+            mIndexVersion = version();
+        }
+        auto iter = mRows.find(ident);
+        return iter == mRows.end() ? -1 : iter->second;
     }
+private:
+    const World &mWorld;
+    const std::vector<T*> &mItems;
+    std::unordered_map<int, unsigned> mRows;
+    unsigned long mIndexVersion;
+};
+
+// Fills a pair of info labels with a realm's name and its species and faction.
+void describeRealm(World &world, const Realm *realm, UILabel *title, UILabel *details) {
+    if (!realm) {
+        title->setText("");
+        details->setText("");
+        return;
+    }
+    std::stringstream l;
+    l << realm->name << " [" << realm->ident << ']';
+    title->setText(l.str());
+
+    std::stringstream l2;
+    Species *s = world.speciesByIdent(realm->primarySpecies);
+    Faction *f = world.factionByIdent(realm->faction);
+    l2 << "Species: ";
+    if (s) l2 << s->name << " [" << s->ident << ']';
+    else    l2 << "none";
+    l2 << "   Faction: ";
+    if (f)  l2 << f->name << " [" << f->ident << ']';
+    else    l2 << "none";
+    details->setText(l2.str());
 }
-void buildFactionList(UIList *list, World &world) {
-    list->items.clear();
-    for (unsigned i = 0; i < world.factions.size(); ++i) {
-        const Faction *fac = world.factions[i];
-        std::stringstream line;
-        line << "\x1" << static_cast<char>(fac->r) << static_cast<char>(fac->g) << static_cast<char>(fac->b);
-        line << ' ' << fac->name << " [" << std::to_string(fac->ident) << "]";
-        list->items.push_back(ListRow{line.str(), fac->ident});
+
+struct Highlight {
+    const Realm *realm;
+    UIColour colour;
+};
+
+// Outlines for the realms picked out by the list selections. Later entries
+// are drawn over earlier ones, so a selected realm beats its species and
+// faction.
+void findHighlights(World &world, std::vector<Highlight> &highlights,
+                    int realmIdent, int speciesIdent, int factionIdent) {
+    highlights.clear();
+    if (factionIdent >= 0) {
+        for (const Realm *realm : world.realms) {
+            if (realm->faction == factionIdent) highlights.push_back(Highlight{realm, GREEN});
+        }
+    }
+    if (speciesIdent >= 0) {
+        for (const Realm *realm : world.realms) {
+            if (realm->primarySpecies == speciesIdent) highlights.push_back(Highlight{realm, BLUE});
+        }
+    }
+    if (realmIdent >= 0) {
+        int pos = world.graph.indexOf(realmIdent);
+        if (pos >= 0) highlights.push_back(Highlight{world.realms[pos], RED});
     }
 }
 
@@ -142,11 +288,20 @@ void innerMain(RenderInfo &r) {
     const int listWidth = 300;
     const int listLeft = screenWidth - listWidth;
 
-    int scaleX = (listLeft - 20) / world.maxX;
-    int scaleY = (mapAreaHeight - 20) / world.maxY;
-    int scale = scaleX;
-    if (scaleY < scaleX) scale = scaleY;
-    int x = 10, y = 10;
+    // the starting view fits the whole world into the map area
+    MapCamera homeCamera;
+    homeCamera.x = 10;
+    homeCamera.y = 10;
+    homeCamera.scale = std::min((listLeft - 20.0) / std::max(1, world.maxX),
+                                (mapAreaHeight - 20.0) / std::max(1, world.maxY));
+    const double minScale = homeCamera.scale / 8;
+    const double maxScale = std::max(64.0, homeCamera.scale);
+    MapCamera camera = homeCamera;
+    bool dragging = false;
+    auto zoomCamera = [&](int screenX, int screenY, double factor) {
+        double target = std::max(minScale, std::min(maxScale, camera.scale * factor));
+        camera.zoomAbout(screenX, screenY, target / camera.scale);
+    };
     // std::string statusMessage = defaultMessage.str();
     Mode colourMode = Mode::Faction;
     Task task = Task::None;
@@ -179,73 +334,62 @@ void innerMain(RenderInfo &r) {
     UIList *realmList = new UIList;
     panel->addChild(realmList, 4, 4);
     realmList->resize(listWidth - 8, screenHeight - infoHeight - 8);
-    buildRealmList(realmList, world);
+    realmList->setModel(new WorldListModel<Realm>(world, world.realms));
 
     UIList *speciesList = new UIList;
     panel->addChild(speciesList, 4, 4);
     speciesList->resize(listWidth - 8, screenHeight - infoHeight - 8);
     speciesList->setShow(false);
-    buildSpeciesList(speciesList, world);
+    speciesList->setModel(new WorldListModel<Species>(world, world.species));
 
     UIList *factionList = new UIList;
     panel->addChild(factionList, 4, 4);
     factionList->resize(listWidth - 8, screenHeight - infoHeight - 8);
     factionList->setShow(false);
-    buildFactionList(factionList, world);
+    factionList->setModel(new WorldListModel<Faction>(world, world.factions));
+
+    MapLayer mapLayer;
+    mapLayer.setArea(0, 0, listLeft, mapAreaHeight);
+    OccupancyGrid occupancy;
+    occupancy.build(world);
+
+    // what the info labels and highlights were last built for, so they are
+    // only rebuilt when it changes
+    const Realm *shownHover = nullptr;
+    UIList *shownList = nullptr;
+    int shownSelection = -1;
+    int shownRealm = -1, shownSpecies = -1, shownFaction = -1;
+    std::vector<Highlight> highlights;
+    FrameScheduler frames(r.frameRate);
+    // last known mouse position, or -1 while it is outside the window
+    int mx = -1, my = -1;
 
     while (1) {
-        int mx = 0, my = 0;
-        SDL_GetMouseState(&mx, &my);
-        int mapX = (mx - x) / scale;
-        int mapY = (my - y) / scale;
+        int mapX = std::floor(camera.mapX(mx));
+        int mapY = std::floor(camera.mapY(my));
         Realm *hoverRealm = nullptr;
-        if (mx <= listLeft && my <= infoTop) {
-            hoverRealm = world.getNearest(mapX, mapY, std::vector<int>{ }, 1);
+        if (mx >= 0 && my >= 0 && mx < listLeft && my < infoTop) {
+            hoverRealm = occupancy.at(mapX, mapY);
         }
 
-        if (hoverRealm) {
-            std::stringstream l;
-            l << hoverRealm->name << " [" << hoverRealm->ident << ']';
-            info1->setText(l.str());
-
-            std::stringstream l2;
-            Species *s = world.speciesByIdent(hoverRealm->primarySpecies);
-            Faction *f = world.factionByIdent(hoverRealm->faction);
-            l2 << "Species: ";
-            if (s) l2 << s->name << " [" << s->ident << ']';
-            else    l2 << "none";
-            l2 << "   Faction: ";
-            if (f)  l2 << f->name << " [" << f->ident << ']';
-            else    l2 << "none";
-            info2->setText(l2.str());
-        } else {
-            info1->setText("");
-            info2->setText("");
+        if (hoverRealm != shownHover) {
+            describeRealm(world, hoverRealm, info1, info2);
+            shownHover = hoverRealm;
+            frames.requestFrame();
         }
-        if (realmList->isShown()) {
-            if (realmList->selection != NO_SELECTION) {
-                Realm *selRealm = world.realmByIdent(realmList->items[realmList->selection].ident);
-                std::stringstream l;
-                l << selRealm->name << " [" << selRealm->ident << ']';
-                info3->setText(l.str());
 
-                std::stringstream l2;
-                Species *s = world.speciesByIdent(selRealm->primarySpecies);
-                Faction *f = world.factionByIdent(selRealm->faction);
-                l2 << "Species: ";
-                if (s) l2 << s->name << " [" << s->ident << ']';
-                else    l2 << "none";
-                l2 << "   Faction: ";
-                if (f)  l2 << f->name << " [" << f->ident << ']';
-                else    l2 << "none";
-                info4->setText(l2.str());
-            } else {
-                info3->setText("");
-                info4->setText("");
-            }
-        } else if (speciesList->isShown()) {
-            if (speciesList->selection != NO_SELECTION) {
-                Species *selSpecies = world.speciesByIdent(speciesList->items[speciesList->selection].ident);
+        UIList *activeList = nullptr;
+        if (realmList->isShown())           activeList = realmList;
+        else if (speciesList->isShown())    activeList = speciesList;
+        else if (factionList->isShown())    activeList = factionList;
+        int activeSelection = activeList ? activeList->selectedIdent() : -1;
+        if (activeList != shownList || activeSelection != shownSelection) {
+            shownList = activeList;
+            shownSelection = activeSelection;
+            if (activeList == realmList) {
+                describeRealm(world, world.realmByIdent(activeSelection), info3, info4);
+            } else if (activeList == speciesList && activeSelection >= 0) {
+                Species *selSpecies = world.speciesByIdent(activeSelection);
                 std::stringstream l;
                 l << selSpecies->name << " [" << selSpecies->ident << ']';
                 info3->setText(l.str());
@@ -253,13 +397,8 @@ void innerMain(RenderInfo &r) {
                 std::stringstream l2;
                 l2 << "stance:" << selSpecies->stance << "  " << selSpecies->wings << "  height:" << selSpecies->height << " cm";
                 info4->setText(l2.str());
-            } else {
-                info3->setText("");
-                info4->setText("");
-            }
-        } else if (factionList->isShown()) {
-            if (factionList->selection != NO_SELECTION) {
-                Faction *selFaction = world.factionByIdent(factionList->items[factionList->selection].ident);
+            } else if (activeList == factionList && activeSelection >= 0) {
+                Faction *selFaction = world.factionByIdent(activeSelection);
                 std::stringstream l;
                 l << selFaction->name << " [" << selFaction->ident << ']';
                 info3->setText(l.str());
@@ -268,95 +407,97 @@ void innerMain(RenderInfo &r) {
                 info3->setText("");
                 info4->setText("");
             }
+            frames.requestFrame();
         }
 
-        r.clear();
-        // DRAW CONNECTIONS
-        r.setColour(WHITE);
-        for (const Realm *realm : world.realms) {
-            for (const Link &l : realm->links) {
-                if (l.linkTo <= realm->ident) continue;
-                const Realm *target = world.realmByIdent(l.linkTo);
-                int rx = x + realm->x * scale + scale / 2;
-                int ry = y + realm->y * scale + scale / 2;
-                int tx = x + target->x * scale + scale / 2;
-                int ty = y + target->y * scale + scale / 2;
-                r.drawLine(rx, ry, tx, ty);
-            }
+        int selRealm = realmList->selectedIdent();
+        int selSpecies = speciesList->selectedIdent();
+        int selFaction = factionList->selectedIdent();
+        if (selRealm != shownRealm || selSpecies != shownSpecies || selFaction != shownFaction) {
+            findHighlights(world, highlights, selRealm, selSpecies, selFaction);
+            shownRealm = selRealm;
+            shownSpecies = selSpecies;
+            shownFaction = selFaction;
+            frames.requestFrame();
         }
 
-        // DRAW MAP
-        for (const Realm *realm : world.realms) {
-            int rx = x + realm->x * scale;
-            int ry = y + realm->y * scale;
-            r.setColour(INVALID);
-            if (colourMode == Mode::Faction) {
-                Faction *f = world.factionByIdent(realm->faction);
-                if (f)  r.setColour(UIColour(f->r, f->g, f->b));
-            } else if (colourMode == Mode::Species) {
-                Species *s = world.speciesByIdent(realm->primarySpecies);
-                if (s)  r.setColour(UIColour(s->r, s->g, s->b));
-            }
-            r.fillRect(rx, ry, scale, scale);
-            if (realm == hoverRealm) {
-                r.setColour(HIGHLIGHT);
-            } else if (realmList->selection != NO_SELECTION && realmList->getSelection().ident == realm->ident) {
-                r.setColour(RED);
-            } else if (speciesList->selection != NO_SELECTION && speciesList->getSelection().ident == realm->primarySpecies) {
-                r.setColour(BLUE);
-            } else if (factionList->selection != NO_SELECTION && factionList->getSelection().ident == realm->faction) {
-                r.setColour(GREEN);
-            } else {
-                r.setColour(MIDGREY);
-            }
-            r.drawRect(rx-1, ry-1, scale+2, scale+2);
-            r.drawRect(rx, ry, scale, scale);
+        if (frames.frameDue()) {
+            r.clear();
+            mapLayer.setMode(colourMode);
+            mapLayer.setCamera(camera);
+            mapLayer.draw(r, world);
+            for (const Highlight &h : highlights) mapLayer.drawOutline(r, h.realm, h.colour);
+            if (hoverRealm) mapLayer.drawOutline(r, hoverRealm, HIGHLIGHT);
+            r.flushBatch();
+
+            root->repaint(r);
+            r.render();
+            frames.frameDrawn();
         }
 
-        root->repaint(r);
-        r.render();
+        frames.wait();
 
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) return;
+            // hover changes are picked up at the top of the loop
+            if (event.type != SDL_MOUSEMOTION) frames.requestFrame();
+            if (event.type == SDL_MOUSEMOTION) {
+                mx = event.motion.x;
+                my = event.motion.y;
+                if (dragging) {
+                    camera.x += event.motion.xrel;
+                    camera.y += event.motion.yrel;
+                    frames.requestFrame();
+                }
+            }
+            if (event.type == SDL_MOUSEBUTTONUP) dragging = false;
+            if (event.type == SDL_MOUSEWHEEL && !root->wheel(mx, my, event.wheel.y)
+                    && mx >= 0 && mx < listLeft && my >= 0 && my < infoTop) {
+                zoomCamera(mx, my, std::pow(1.25, event.wheel.y));
+            }
+            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_LEAVE) {
+                mx = my = -1;
+            }
+            if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) {
+                mapLayer.invalidate();
+            }
+            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                mapLayer.invalidate();
+            }
+            // the right and middle buttons drag the map around
+            if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button != SDL_BUTTON_LEFT
+                    && event.button.x < listLeft && event.button.y < infoTop) {
+                dragging = true;
+                continue;
+            }
             if (event.type == SDL_MOUSEBUTTONDOWN) {
                 statusMessage->setText("");
                 if (root->click(event.button.x, event.button.y)) break;
                 switch(task) {
                     case Task::Move: {
                         task = Task::None;
-                        Realm *existing = world.getNearest(mapX, mapY, std::vector<int>{ }, 1);
-                        if (existing) {
+                        // the map layer and exports only cover the world's extents
+                        if (mapX < 0 || mapY < 0 || mapX > world.maxX || mapY > world.maxY) {
+                            statusMessage->setText("Space is outside the map.");
+                        } else if (occupancy.at(mapX, mapY)) {
                             statusMessage->setText("Space already occupied.");
                         } else {
-                            taskRealm->x = mapX;
-                            taskRealm->y = mapY;
+                            occupancy.move(taskRealm, mapX, mapY);
                             taskRealm = nullptr;
+                            world.rebuildPositions();
+                            world.markChanged();
+                            mapLayer.invalidate();
                         }
                         break; }
                     case Task::None:
                         if (hoverRealm) {
                             if (realmList->isShown()) {
-                                for (unsigned i = 0; i < realmList->items.size(); ++i) {
-                                    if (realmList->items[i].ident == hoverRealm->ident) {
-                                        realmList->selection = i;
-                                        break;
-                                    }
-                                }
+                                realmList->selectIdent(hoverRealm->ident);
                             } else if (speciesList->isShown()) {
-                                for (unsigned i = 0; i < speciesList->items.size(); ++i) {
-                                    if (speciesList->items[i].ident == hoverRealm->primarySpecies) {
-                                        speciesList->selection = i;
-                                        break;
-                                    }
-                                }
+                                speciesList->selectIdent(hoverRealm->primarySpecies);
                             } else if (factionList->isShown()) {
-                                for (unsigned i = 0; i < factionList->items.size(); ++i) {
-                                    if (factionList->items[i].ident == hoverRealm->faction) {
-                                        factionList->setSelection(i);
-                                        break;
-                                    }
-                                }
+                                factionList->selectIdent(hoverRealm->faction);
                             }
                         }
                         break;
@@ -398,6 +539,9 @@ void innerMain(RenderInfo &r) {
                     case SDLK_s:
                         colourMode = Mode::Species;
                         break;
+                    case SDLK_b:
+                        colourMode = Mode::Biome;
+                        break;
                     case SDLK_m:
                         if (hoverRealm) {
                             taskRealm = hoverRealm;
@@ -409,12 +553,27 @@ void innerMain(RenderInfo &r) {
                         if (root->isShown()) root->setShow(false);
                         else root->setShow(true);
                         break;
-                    // case SDLK_LEFTBRACKET:
-                    //     if (scale > 1) --scale;
-                    //     break;
-                    // case SDLK_RIGHTBRACKET:
-                    //     if (scale < 40) ++scale;
-                    //     break;
+                    case SDLK_LEFTBRACKET:
+                        zoomCamera(listLeft / 2, mapAreaHeight / 2, 1 / 1.25);
+                        break;
+                    case SDLK_RIGHTBRACKET:
+                        zoomCamera(listLeft / 2, mapAreaHeight / 2, 1.25);
+                        break;
+                    case SDLK_LEFT:
+                        camera.x += listLeft / 8;
+                        break;
+                    case SDLK_RIGHT:
+                        camera.x -= listLeft / 8;
+                        break;
+                    case SDLK_UP:
+                        camera.y += mapAreaHeight / 8;
+                        break;
+                    case SDLK_DOWN:
+                        camera.y -= mapAreaHeight / 8;
+                        break;
+                    case SDLK_HOME:
+                        camera = homeCamera;
+                        break;
                 }
             }
         }
@@ -1,14 +1,21 @@
 #ifndef VIEWER_H_489302
 #define VIEWER_H_489302
 
+#include <cmath>
+#include <iosfwd>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 struct RenderInfo;
+class HeadlessRun;
+struct Realm;
+struct World;
 
 struct UIColour {
     explicit UIColour(int s) : r(s), g(s), b(s) { }
     UIColour(int r, int g, int b) : r(r), g(g), b(b) { }
+    bool operator==(const UIColour &o) const { return r == o.r && g == o.g && b == o.b; }
 
     int r, g, b;
 };
@@ -31,9 +38,12 @@ public:
 
     void repaint(RenderInfo &r) { if (!mShown) return; draw(r); }
     bool click(int x, int y)    { if (!mShown) return false; return handleClick(x, y); }
+    bool wheel(int x, int y, int amount) { if (!mShown) return false; return handleWheel(x, y, amount); }
 
     virtual void draw(RenderInfo &r) = 0;
     virtual bool handleClick(int x, int y) = 0;
+    // amount is positive for scrolling up or away
+    virtual bool handleWheel(int x, int y, int amount) { return false; }
 protected:
     int mX, mY, mWidth, mHeight;
     std::vector<UIWidget*> mChildren;
@@ -54,35 +64,92 @@ private:
     std::string mText;
 };
 
-struct ListRow {
-    std::string text;
-    int ident;
+// Supplies the rows shown by a UIList. Rows are only asked for as they
+// scroll into view, so a model never has to format all of them.
+class ListModel {
+public:
+    virtual ~ListModel() { }
+    virtual unsigned size() const = 0;
+    virtual int identAt(unsigned row) const = 0;
+    virtual std::string textAt(unsigned row) const = 0;
+    // the row showing ident, or -1 if there is none
+    virtual int rowOf(int ident) = 0;
+    // changes whenever rows may have changed, so cached text can be dropped
+    virtual unsigned long version() const = 0;
 };
+
 class UIList : public UIWidget {
 public:
     UIList();
+    virtual ~UIList();
+    // the list takes ownership of model
+    void setModel(ListModel *model);
     virtual void draw(RenderInfo &r) override;
     virtual bool handleClick(int x, int y) override;
+    virtual bool handleWheel(int x, int y, int amount) override;
 
-    ListRow& getSelection();
-    void setSelection(unsigned index);
-
-    std::vector<ListRow> items;
-    unsigned selection;
+    unsigned getSelection() const { return mSelection; }
+    int selectedIdent() const;
+    void setSelection(unsigned row);
+    bool selectIdent(int ident);
+    void scrollTo(unsigned row);
 private:
+    unsigned rowCount() const { return mModel ? mModel->size() : 0; }
+    unsigned visibleRows() const;
+    unsigned lastTopRow() const;
+    const std::string& rowText(unsigned row);
+
+    ListModel *mModel;
+    unsigned mSelection;
+    unsigned mTopRow;
     int lineHeight;
+    // text of rows drawn recently, as of model version mTextVersion
+    std::unordered_map<unsigned, std::string> mRowText;
+    unsigned long mTextVersion;
 };
 
 class UIPanel : public UIWidget {
 public:
     virtual void draw(RenderInfo &r) override;
     virtual bool handleClick(int x, int y) override;
+    virtual bool handleWheel(int x, int y, int amount) override;
 };
 
 class UIRoot : public UIWidget {
 public:
     virtual void draw(RenderInfo &r) override;
     virtual bool handleClick(int x, int y) override;
+    virtual bool handleWheel(int x, int y, int amount) override;
+};
+
+// Coloured rectangles and lines collected so that a whole layer reaches the
+// renderer in a few calls. flush() draws everything queued, in the order it
+// was added, and empties the batch. Lines are one pixel wide.
+class RenderBatch {
+public:
+    void drawLine(int x1, int y1, int x2, int y2, const UIColour &c);
+    void drawRect(int x, int y, int w, int h, const UIColour &c);
+    void fillRect(int x, int y, int w, int h, const UIColour &c);
+    void flush(SDL_Renderer *renderer);
+private:
+#if SDL_VERSION_ATLEAST(2,0,18)
+    // everything becomes triangles for SDL_RenderGeometry
+    void addQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4,
+                 const UIColour &c);
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+#else
+    // runs of one colour and kind, each drawn with a single call
+    struct Run {
+        bool lines;
+        UIColour colour;
+        unsigned first, count;
+    };
+    Run& runFor(bool lines, const UIColour &c);
+    std::vector<Run> runs;
+    std::vector<SDL_Rect> rects;
+    std::vector<SDL_Point> points;
+#endif
 };
 
 struct RenderInfo {
@@ -97,11 +164,154 @@ struct RenderInfo {
     SDL_Texture* loadTexture(const std::string filename);
     void render();
     void setColour(const UIColour &c);
+    void flushBatch() { batch.flush(renderer); }
 
+    RenderBatch batch;
     SDL_Window *window;
     SDL_Renderer *renderer;
     int fontWidth, fontHeight;
     SDL_Texture *font;
+    int frameRate = 0; // frames per second for animation, 0 to draw only on change
+    HeadlessRun *headless = nullptr;
+};
+
+// Runs the viewer without a display, for benchmarking. Every presented frame
+// is timed and answered with the next step of a fixed input script: hover
+// sweeps, colour mode and zoom changes, list scrolling and realm page flips.
+// Frames can also be saved as BMPs to compare against earlier runs.
+class HeadlessRun {
+public:
+    HeadlessRun(SDL_Surface *screen, unsigned frames, const std::string &dumpDir);
+    void frameDone();
+    void report(std::ostream &out) const;
+private:
+    void queueStep(unsigned step);
+
+    SDL_Surface *mScreen;
+    unsigned mFrames;
+    std::string mDumpDir;
+    std::vector<double> mTimes; // milliseconds, in frame order
+    Uint64 mStepStart;
+};
+
+// Paces a screen's main loop. wait() sleeps in SDL_WaitEventTimeout until an
+// event is queued or, in fixed-rate mode, the next frame is due; the loop
+// then draws only if frameDue(). Anything that changes what is on screen,
+// including work finishing outside the event queue, calls requestFrame().
+class FrameScheduler {
+public:
+    explicit FrameScheduler(int frameRate = 0);
+
+    void requestFrame() { mFrameDue = true; }
+    bool frameDue() const { return mFrameDue; }
+    void frameDrawn();
+    void wait();
+private:
+    int mFrameRate;
+    Uint32 mLastFrame;
+    bool mFrameDue;
+};
+
+enum class Mode { Faction, Species, Realm, Biome };
+
+// Maps world coordinates to the screen: map (0,0) is drawn at (x, y) and
+// each map unit is scale pixels across.
+struct MapCamera {
+    double x = 0, y = 0;
+    double scale = 1;
+
+    int screenX(double mapX) const { return std::floor(x + mapX * scale); }
+    int screenY(double mapY) const { return std::floor(y + mapY * scale); }
+    double mapX(int screenX) const { return (screenX - x) / scale; }
+    double mapY(int screenY) const { return (screenY - y) / scale; }
+    // changes the scale by factor while keeping the map point under
+    // (screenX, screenY) where it is
+    void zoomAbout(int screenX, int screenY, double factor);
+    bool operator==(const MapCamera &other) const {
+        return x == other.x && y == other.y && scale == other.scale;
+    }
+};
+
+// The part of the main map that only changes when the world is edited or
+// the camera moves: link lines and realm tiles with their plain outlines. It
+// is drawn into a target texture and that is copied to the screen each frame
+// until it goes out of date; hover and selection outlines are drawn over it
+// by the caller. Only realms and links that can be seen are drawn, and when
+// zoomed far out the realms are replaced by density tiles and only long
+// links are kept.
+class MapLayer {
+public:
+    MapLayer();
+    ~MapLayer();
+
+    // screen area covered by the layer
+    void setArea(int x, int y, int width, int height);
+    void setCamera(const MapCamera &camera);
+    void setMode(Mode mode);
+    void invalidate() { mDirty = true; }
+
+    void draw(RenderInfo &r, World &world);
+    // draws straight to the current render target, keeping nothing
+    void drawUncached(RenderInfo &r, World &world);
+    // realm names, when zoomed in far enough to fit them
+    void drawLabels(RenderInfo &r, World &world);
+    // queued on r.batch, to be sent with r.flushBatch()
+    void drawOutline(RenderInfo &r, const Realm *realm, const UIColour &colour);
+private:
+    struct DensityCell {
+        unsigned count, r, g, b;
+    };
+    struct DensityLevel {
+        int cellSize, columns, rows;
+        unsigned peak;
+        std::vector<DensityCell> cells;
+    };
+    struct MapLink {
+        unsigned from, to;
+        double length;
+    };
+
+    int colourKey(const Realm *realm) const;
+    bool updateIndexes(World &world);
+    void buildDensity(World &world);
+    void buildLinks(World &world);
+    void drawContents(RenderInfo &r, World &world, int offsetX, int offsetY);
+    void drawRealms(RenderInfo &r, World &world, int offsetX, int offsetY);
+    void drawDensity(RenderInfo &r, World &world, int offsetX, int offsetY);
+
+    SDL_Texture *mTexture;
+    int mX, mY, mWidth, mHeight;
+    MapCamera mCamera;
+    Mode mMode;
+    bool mDirty;
+
+    // built from the world at mRevision, colours and density in mode mIndexMode
+    const World *mWorld;
+    unsigned long mRevision;
+    Mode mIndexMode;
+    std::unordered_map<int, UIColour> mColours;
+    std::vector<DensityLevel> mDensity;
+    std::vector<MapLink> mLongLinks; // longest first
+    int mLongestLink;
+
+    std::vector<unsigned> mVisible;
+    std::vector<char> mMarked;
+};
+
+// Which realm sits on each map square. Realms only ever occupy whole
+// squares, so finding the one under the mouse is a single hash lookup, and
+// moving a realm updates just its old and new squares.
+class OccupancyGrid {
+public:
+    void build(World &world);
+    Realm* at(int x, int y) const;
+    // moves the realm to (x, y), which should be empty
+    void move(Realm *realm, int x, int y);
+private:
+    static unsigned long long key(int x, int y) {
+        return static_cast<unsigned long long>(static_cast<unsigned>(x)) << 32 | static_cast<unsigned>(y);
+    }
+    std::unordered_map<unsigned long long, Realm*> mCells;
 };
 
 const unsigned NO_SELECTION = -1;
@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <SDL.h>
+#include <zlib.h>
+
+#include "../src/realms.h"
+#include "viewer.h"
+
+// the image is drawn in square tiles this many pixels across, one band of
+// tiles at a time, so only a band of rows is ever held in memory
+const int EXPORT_TILE_SIZE = 512;
+// blank border around the map, in pixels
+const int EXPORT_MARGIN = 8;
+
+// Takes an image a band of rows at a time, top to bottom. Rows are packed
+// RGB with no padding.
+class ImageWriter {
+public:
+    virtual ~ImageWriter() { if (mFile) fclose(mFile); }
+    virtual bool writeRows(const unsigned char *rows, int count) = 0;
+    virtual bool finish() = 0;
+protected:
+    ImageWriter(FILE *file, int width, int height) : mFile(file), mWidth(width), mHeight(height) { }
+    FILE *mFile;
+    int mWidth, mHeight;
+};
+
+static void putLE(unsigned char *to, unsigned value, int bytes) {
+    for (int i = 0; i < bytes; ++i) to[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static void putBE(unsigned char *to, unsigned value) {
+    for (int i = 0; i < 4; ++i) to[i] = (value >> (24 - 8 * i)) & 0xFF;
+}
+
+// 24-bit BMP, stored top-down so rows can go out in the order they are drawn.
+class BmpWriter : public ImageWriter {
+public:
+    BmpWriter(FILE *file, int width, int height)
+    : ImageWriter(file, width, height), mRow((width * 3 + 3) & ~3, 0)
+    { }
+
+    bool start() {
+        unsigned char header[54] = { 'B', 'M' };
+        putLE(header + 2, 54 + mRow.size() * mHeight, 4);
+        putLE(header + 10, 54, 4);
+        putLE(header + 14, 40, 4);
+        putLE(header + 18, mWidth, 4);
+        putLE(header + 22, -mHeight, 4);
+        putLE(header + 26, 1, 2);
+        putLE(header + 28, 24, 2);
+        putLE(header + 38, 2835, 4); // 72 dpi
+        putLE(header + 42, 2835, 4);
+        return fwrite(header, sizeof(header), 1, mFile) == 1;
+    }
+    bool writeRows(const unsigned char *rows, int count) override {
+        for (int y = 0; y < count; ++y) {
+            const unsigned char *from = rows + y * mWidth * 3;
+            for (int x = 0; x < mWidth; ++x) {
+                mRow[x * 3] = from[x * 3 + 2];
+                mRow[x * 3 + 1] = from[x * 3 + 1];
+                mRow[x * 3 + 2] = from[x * 3];
+            }
+            if (fwrite(mRow.data(), mRow.size(), 1, mFile) != 1) return false;
+        }
+        return true;
+    }
+    bool finish() override {
+        return fflush(mFile) == 0;
+    }
+private:
+    std::vector<unsigned char> mRow;
+};
+
+// 8-bit RGB PNG. Rows are Sub filtered and deflated as they arrive, and the
+// compressed data goes out in IDAT chunks whenever the buffer fills.
+class PngWriter : public ImageWriter {
+public:
+    PngWriter(FILE *file, int width, int height)
+    : ImageWriter(file, width, height), mRow(width * 3 + 1), mOut(1 << 16), mStarted(false)
+    { }
+    ~PngWriter() {
+        if (mStarted) deflateEnd(&mStream);
+    }
+
+    bool start() {
+        const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        if (fwrite(signature, sizeof(signature), 1, mFile) != 1) return false;
+        unsigned char header[13] = { };
+        putBE(header, mWidth);
+        putBE(header + 4, mHeight);
+        header[8] = 8; // bits per channel
+        header[9] = 2; // RGB
+        if (!writeChunk("IHDR", header, sizeof(header))) return false;
+
+        mStream = z_stream();
+        if (deflateInit(&mStream, Z_DEFAULT_COMPRESSION) != Z_OK) return false;
+        mStarted = true;
+        mStream.next_out = mOut.data();
+        mStream.avail_out = mOut.size();
+        return true;
+    }
+    bool writeRows(const unsigned char *rows, int count) override {
+        const int rowBytes = mWidth * 3;
+        for (int y = 0; y < count; ++y) {
+            const unsigned char *from = rows + y * rowBytes;
+            mRow[0] = 1; // Sub: each byte less the same channel of the pixel to its left
+            for (int i = 0; i < rowBytes; ++i) {
+                mRow[i + 1] = from[i] - (i >= 3 ? from[i - 3] : 0);
+            }
+            if (!compress(mRow.data(), mRow.size(), Z_NO_FLUSH)) return false;
+        }
+        return true;
+    }
+    bool finish() override {
+        if (!compress(nullptr, 0, Z_FINISH)) return false;
+        if (!writeChunk("IEND", nullptr, 0)) return false;
+        return fflush(mFile) == 0;
+    }
+private:
+    bool writeChunk(const char *type, const unsigned char *data, unsigned length) {
+        unsigned char header[8];
+        putBE(header, length);
+        memcpy(header + 4, type, 4);
+        unsigned long crc = crc32(0, header + 4, 4);
+        if (length > 0) crc = crc32(crc, data, length);
+        unsigned char footer[4];
+        putBE(footer, crc);
+        if (fwrite(header, sizeof(header), 1, mFile) != 1) return false;
+        if (length > 0 && fwrite(data, length, 1, mFile) != 1) return false;
+        return fwrite(footer, sizeof(footer), 1, mFile) == 1;
+    }
+    bool compress(unsigned char *data, unsigned length, int flush) {
+        mStream.next_in = data;
+        mStream.avail_in = length;
+        for (;;) {
+            int result = deflate(&mStream, flush);
+            if (result == Z_STREAM_ERROR) return false;
+            if (mStream.avail_out == 0 || (result == Z_STREAM_END && mStream.avail_out < mOut.size())) {
+                if (!writeChunk("IDAT", mOut.data(), mOut.size() - mStream.avail_out)) return false;
+                mStream.next_out = mOut.data();
+                mStream.avail_out = mOut.size();
+            }
+            if (result == Z_STREAM_END) return true;
+            if (flush != Z_FINISH && mStream.avail_in == 0 && mStream.avail_out > 0) return true;
+        }
+    }
+
+    std::vector<unsigned char> mRow, mOut;
+    z_stream mStream;
+    bool mStarted;
+};
+
+// Opens filename and writes the image header, as a PNG when png is set and
+// a BMP otherwise. Returns nullptr on failure.
+static ImageWriter* startImage(const std::string &filename, bool png, int width, int height) {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open " << filename << " for writing.\n";
+        return nullptr;
+    }
+    bool started;
+    ImageWriter *writer;
+    if (png) {
+        PngWriter *p = new PngWriter(file, width, height);
+        started = p->start();
+        writer = p;
+    } else {
+        BmpWriter *b = new BmpWriter(file, width, height);
+        started = b->start();
+        writer = b;
+    }
+    if (!started) {
+        std::cerr << "Failed to write " << filename << ".\n";
+        delete writer;
+        return nullptr;
+    }
+    return writer;
+}
+
+// One worker's drawing state, kept for the whole export: a tile sized
+// surface with a software renderer on it and a map layer over the world.
+struct TileRenderer {
+    SDL_Surface *surface = nullptr;
+    RenderInfo rInfo;
+    MapLayer layer;
+
+    TileRenderer() { rInfo.renderer = nullptr; rInfo.font = nullptr; }
+    ~TileRenderer() {
+        if (rInfo.font) SDL_DestroyTexture(rInfo.font);
+        if (rInfo.renderer) SDL_DestroyRenderer(rInfo.renderer);
+        if (surface) SDL_FreeSurface(surface);
+    }
+};
+
+// Sets up count workers drawing size pixel square tiles. The font is only
+// loaded when labels are wanted.
+static bool startTileRenderers(std::vector<std::unique_ptr<TileRenderer>> &tiles, int count, int size,
+                               Mode mode, bool labels) {
+    for (int i = 0; i < count; ++i) {
+        TileRenderer *tile = new TileRenderer;
+        tiles.emplace_back(tile);
+        tile->surface = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_RGB888);
+        if (!tile->surface) {
+            std::cerr << "SDL_CreateRGBSurfaceWithFormat Error: " << SDL_GetError() << '\n';
+            return false;
+        }
+        tile->rInfo.window = nullptr;
+        tile->rInfo.renderer = SDL_CreateSoftwareRenderer(tile->surface);
+        if (!tile->rInfo.renderer) {
+            std::cerr << "SDL_CreateSoftwareRenderer Error: " << SDL_GetError() << '\n';
+            return false;
+        }
+        tile->rInfo.fontWidth = 9;
+        tile->rInfo.fontHeight = 18;
+        if (labels) tile->rInfo.font = tile->rInfo.loadTexture("gfx/font.bmp");
+        tile->layer.setArea(0, 0, size, size);
+        tile->layer.setMode(mode);
+    }
+    return true;
+}
+
+// Draws the map with the camera given, reading back the top left width by
+// height pixels as packed RGB rows pitch bytes apart.
+static bool drawTile(TileRenderer &tile, World &world, const MapCamera &camera,
+                     int width, int height, unsigned char *pixels, int pitch) {
+    tile.layer.setCamera(camera);
+    tile.rInfo.clear();
+    tile.layer.drawUncached(tile.rInfo, world);
+    tile.layer.drawLabels(tile.rInfo, world);
+
+    SDL_Rect area = { 0, 0, width, height };
+    return SDL_RenderReadPixels(tile.rInfo.renderer, &area, SDL_PIXELFORMAT_RGB24, pixels, pitch) == 0;
+}
+
+static bool loadWorld(World &world) {
+    if (!world.readFromFile("realms.txt")) {
+        std::cerr << "Failed to read realms data.\n";
+        return false;
+    }
+    return true;
+}
+
+// Writes the whole map to a PNG or BMP file, chosen by its extension, with
+// each map unit scale pixels across. Tiles are drawn by the same map layer
+// as the viewer, each worker thread with its own software renderer, so no
+// display is needed.
+int runExport(const std::string &filename, Mode mode, int scale, int threads) {
+    std::string extension = filename.size() > 4 ? filename.substr(filename.size() - 4) : "";
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension != ".png" && extension != ".bmp") {
+        std::cerr << "Export file name must end in .png or .bmp.\n";
+        return 1;
+    }
+
+    if (SDL_Init(0) != 0) {
+        std::cerr << "SDL_Init Error: " << SDL_GetError() << '\n';
+        return 1;
+    }
+
+    World world;
+    if (!loadWorld(world)) {
+        SDL_Quit();
+        return 1;
+    }
+    const long long longWidth = (world.maxX + 1LL) * scale + EXPORT_MARGIN * 2;
+    const long long longHeight = (world.maxY + 1LL) * scale + EXPORT_MARGIN * 2;
+    if (longWidth > 0x7FFFFFF || longHeight > 0x7FFFFFF) {
+        std::cerr << "A " << longWidth << 'x' << longHeight << " image is too large to export.\n";
+        SDL_Quit();
+        return 1;
+    }
+    const int width = longWidth;
+    const int height = longHeight;
+
+    const int columns = (width + EXPORT_TILE_SIZE - 1) / EXPORT_TILE_SIZE;
+    threads = std::max(1, std::min(threads, columns));
+    std::unique_ptr<ImageWriter> writer(startImage(filename, extension == ".png", width, height));
+    std::vector<std::unique_ptr<TileRenderer>> tiles;
+    if (!writer || !startTileRenderers(tiles, threads, EXPORT_TILE_SIZE, mode, false)) {
+        std::cerr << "Failed to start exporting " << filename << ".\n";
+        writer.reset();
+        tiles.clear();
+        remove(filename.c_str());
+        SDL_Quit();
+        return 1;
+    }
+
+    std::cerr << "Exporting " << width << 'x' << height << " map with " << threads << " thread(s)";
+    const int rows = (height + EXPORT_TILE_SIZE - 1) / EXPORT_TILE_SIZE;
+    std::vector<unsigned char> band(static_cast<size_t>(width) * EXPORT_TILE_SIZE * 3);
+    bool failed = false;
+    for (int row = 0; row < rows && !failed; ++row) {
+        const int top = row * EXPORT_TILE_SIZE;
+        const int bandHeight = std::min(EXPORT_TILE_SIZE, height - top);
+        std::atomic<int> nextColumn(0);
+        std::atomic<bool> tileFailed(false);
+        auto work = [&](TileRenderer &tile) {
+            for (int column = nextColumn++; column < columns; column = nextColumn++) {
+                const int left = column * EXPORT_TILE_SIZE;
+                MapCamera camera;
+                camera.x = EXPORT_MARGIN - left;
+                camera.y = EXPORT_MARGIN - top;
+                camera.scale = scale;
+                if (!drawTile(tile, world, camera, std::min(EXPORT_TILE_SIZE, width - left), bandHeight,
+                              band.data() + left * 3, width * 3)) {
+                    tileFailed = true;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; ++i) workers.emplace_back(work, std::ref(*tiles[i]));
+        work(*tiles[0]);
+        for (std::thread &t : workers) t.join();
+
+        if (tileFailed) {
+            std::cerr << "\nSDL_RenderReadPixels Error: " << SDL_GetError() << '\n';
+            failed = true;
+        } else if (!writer->writeRows(band.data(), bandHeight)) {
+            failed = true;
+        }
+        std::cerr << '.';
+    }
+    if (!failed && !writer->finish()) failed = true;
+    writer.reset();
+    tiles.clear();
+    SDL_Quit();
+
+    if (failed) {
+        std::cerr << "\nFailed to write " << filename << ".\n";
+        remove(filename.c_str());
+        return 1;
+    }
+    std::cerr << "\nWrote " << filename << ".\n";
+    return 0;
+}
+
+// Creates a directory, succeeding if it is already there.
+static bool makeDirectory(const std::string &path) {
+#ifdef _WIN32
+    if (_mkdir(path.c_str()) == 0) return true;
+#else
+    if (mkdir(path.c_str(), 0777) == 0) return true;
+#endif
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+static bool fileExists(const std::string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+// FNV-1a over the tile's pixels
+static unsigned long long hashPixels(const std::vector<unsigned char> &pixels) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned char c : pixels) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static unsigned long long tileKey(int zoom, int x, int y) {
+    return static_cast<unsigned long long>(zoom) << 48 | static_cast<unsigned long long>(x) << 24 | y;
+}
+
+// The hashes file holds a "zoom x y hash" line for every tile written by the
+// last export to the directory.
+static void readTileHashes(const std::string &filename, std::unordered_map<unsigned long long, unsigned long long> &hashes) {
+    std::ifstream in(filename);
+    int zoom, x, y;
+    unsigned long long hash;
+    while (in >> zoom >> x >> y >> std::hex >> hash >> std::dec) {
+        hashes[tileKey(zoom, x, y)] = hash;
+    }
+}
+
+// Writes the map as a pyramid of TILE_PIXELS square tiles in
+// directory/zoom/x/y.png (or .bmp), as used by web slippy maps. At zoom 0
+// the longer side of the map fits one tile and each zoom level doubles the
+// scale; every level is drawn with the viewer's map layer, so it gets the
+// same density tiles, outlines and link culling the viewer shows at that
+// scale, and names once the tiles are large enough. Every tile is still
+// drawn on each export, but tiles whose pixels hash the same as on the last
+// export to the directory are not encoded or written again.
+int runTileExport(const std::string &directory, bool png, Mode mode, int maxZoom, int threads) {
+    const int TILE_PIXELS = 256;
+    // most tiles in one zoom level; deeper levels are left out
+    const long long MAX_LEVEL_TILES = 1 << 24;
+
+    if (SDL_Init(0) != 0) {
+        std::cerr << "SDL_Init Error: " << SDL_GetError() << '\n';
+        return 1;
+    }
+    World world;
+    if (!loadWorld(world)) {
+        SDL_Quit();
+        return 1;
+    }
+    const int side = std::max(world.maxX, world.maxY) + 1;
+    if (maxZoom < 0) {
+        // deep enough for names to show
+        maxZoom = 0;
+        while (maxZoom < 12 && TILE_PIXELS * (1 << maxZoom) < side * 16) ++maxZoom;
+    }
+    maxZoom = std::min(maxZoom, 20);
+    auto levelSize = [&](int zoom, int &columns, int &rows) {
+        const double scale = static_cast<double>(TILE_PIXELS << zoom) / side;
+        columns = std::ceil((world.maxX + 1) * scale / TILE_PIXELS);
+        rows = std::ceil((world.maxY + 1) * scale / TILE_PIXELS);
+        return static_cast<long long>(columns) * rows;
+    };
+    int columns, rows;
+    if (levelSize(maxZoom, columns, rows) > MAX_LEVEL_TILES) {
+        while (maxZoom > 0 && levelSize(maxZoom, columns, rows) > MAX_LEVEL_TILES) --maxZoom;
+        std::cerr << "Too many tiles for deeper zoom levels; stopping at zoom " << maxZoom << ".\n";
+    }
+
+    std::vector<std::unique_ptr<TileRenderer>> tiles;
+    if (!makeDirectory(directory) || !startTileRenderers(tiles, threads, TILE_PIXELS, mode, true)) {
+        std::cerr << "Failed to start exporting tiles to " << directory << ".\n";
+        tiles.clear();
+        SDL_Quit();
+        return 1;
+    }
+
+    const std::string hashFile = directory + "/tiles.hash";
+    std::unordered_map<unsigned long long, unsigned long long> oldHashes;
+    readTileHashes(hashFile, oldHashes);
+    std::ofstream newHashes(hashFile + ".new");
+    const std::string extension = png ? ".png" : ".bmp";
+
+    bool failed = false;
+    unsigned long long written = 0, unchanged = 0;
+    for (int zoom = 0; zoom <= maxZoom && !failed; ++zoom) {
+        const double scale = static_cast<double>(TILE_PIXELS << zoom) / side;
+        const long long tileCount = levelSize(zoom, columns, rows);
+        const std::string zoomDir = directory + "/" + std::to_string(zoom);
+        failed = !makeDirectory(zoomDir);
+        for (int x = 0; x < columns && !failed; ++x) {
+            failed = !makeDirectory(zoomDir + "/" + std::to_string(x));
+        }
+        if (failed) {
+            std::cerr << "Failed to create the directories for zoom " << zoom << ".\n";
+            break;
+        }
+
+        std::vector<unsigned long long> hashes(tileCount);
+        std::atomic<long long> nextTile(0);
+        std::atomic<unsigned long long> levelWritten(0);
+        std::atomic<bool> tileFailed(false);
+        auto work = [&](TileRenderer &tile) {
+            std::vector<unsigned char> pixels(TILE_PIXELS * TILE_PIXELS * 3);
+            for (long long n = nextTile++; n < tileCount && !tileFailed; n = nextTile++) {
+                const int x = n / rows, y = n % rows;
+                MapCamera camera;
+                camera.x = -x * TILE_PIXELS;
+                camera.y = -y * TILE_PIXELS;
+                camera.scale = scale;
+                if (!drawTile(tile, world, camera, TILE_PIXELS, TILE_PIXELS, pixels.data(), TILE_PIXELS * 3)) {
+                    std::cerr << "SDL_RenderReadPixels Error: " << SDL_GetError() << '\n';
+                    tileFailed = true;
+                    break;
+                }
+                hashes[n] = hashPixels(pixels);
+
+                const std::string filename = zoomDir + "/" + std::to_string(x) + "/" + std::to_string(y) + extension;
+                auto old = oldHashes.find(tileKey(zoom, x, y));
+                if (old != oldHashes.end() && old->second == hashes[n] && fileExists(filename)) continue;
+                std::unique_ptr<ImageWriter> writer(startImage(filename, png, TILE_PIXELS, TILE_PIXELS));
+                if (!writer || !writer->writeRows(pixels.data(), TILE_PIXELS) || !writer->finish()) {
+                    tileFailed = true;
+                    break;
+                }
+                ++levelWritten;
+            }
+        };
+        const int levelThreads = std::max(1LL, std::min<long long>(threads, tileCount));
+        std::vector<std::thread> workers;
+        for (int i = 1; i < levelThreads; ++i) workers.emplace_back(work, std::ref(*tiles[i]));
+        work(*tiles[0]);
+        for (std::thread &t : workers) t.join();
+        failed = tileFailed;
+
+        for (long long n = 0; n < tileCount && !failed; ++n) {
+            newHashes << zoom << ' ' << n / rows << ' ' << n % rows << ' ' << std::hex << hashes[n] << std::dec << '\n';
+        }
+        written += levelWritten;
+        unchanged += tileCount - levelWritten;
+        std::cerr << "Zoom " << zoom << ": " << columns << 'x' << rows << " tiles, " << levelWritten << " written.\n";
+    }
+    tiles.clear();
+    SDL_Quit();
+
+    newHashes.close();
+    if (failed || !newHashes) {
+        std::cerr << "Failed to export tiles to " << directory << ".\n";
+        remove((hashFile + ".new").c_str());
+        return 1;
+    }
+    remove(hashFile.c_str());
+    rename((hashFile + ".new").c_str(), hashFile.c_str());
+    std::cerr << "Wrote " << written << " tiles to " << directory << ", " << unchanged << " unchanged.\n";
+    return 0;
+}
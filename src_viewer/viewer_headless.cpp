@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+#include "../src/realms.h"
+#include "viewer.h"
+
+void innerMain(RenderInfo &r);
+
+// each part of the script runs for this many frames before the next starts
+const unsigned SCRIPT_PHASE_FRAMES = 60;
+
+HeadlessRun::HeadlessRun(SDL_Surface *screen, unsigned frames, const std::string &dumpDir)
+: mScreen(screen), mFrames(frames), mDumpDir(dumpDir), mStepStart(SDL_GetPerformanceCounter())
+{ }
+
+void HeadlessRun::frameDone() {
+    Uint64 now = SDL_GetPerformanceCounter();
+    mTimes.push_back((now - mStepStart) * 1000.0 / SDL_GetPerformanceFrequency());
+
+    if (!mDumpDir.empty()) {
+        char filename[32];
+        snprintf(filename, sizeof(filename), "/frame_%05u.bmp", static_cast<unsigned>(mTimes.size()));
+        if (SDL_SaveBMP(mScreen, (mDumpDir + filename).c_str()) != 0) {
+            std::cerr << "SDL_SaveBMP Error: " << SDL_GetError() << '\n';
+            mDumpDir.clear();
+        }
+    }
+
+    if (mTimes.size() >= mFrames) {
+        // every screen leaves on SDL_QUIT, and each one it returns to draws
+        // a frame first, so one quit per frame unwinds them all
+        SDL_Event event = { };
+        event.type = SDL_QUIT;
+        SDL_PushEvent(&event);
+    } else {
+        queueStep(mTimes.size());
+    }
+    mStepStart = SDL_GetPerformanceCounter();
+}
+
+static void pushKey(SDL_Keycode key) {
+    SDL_Event event = { };
+    event.type = SDL_KEYDOWN;
+    event.key.keysym.sym = key;
+    SDL_PushEvent(&event);
+}
+
+static void pushMouse(int x, int y) {
+    SDL_Event event = { };
+    event.type = SDL_MOUSEMOTION;
+    event.motion.x = x;
+    event.motion.y = y;
+    SDL_PushEvent(&event);
+}
+
+// Queues the input for a step. Steps that only move the mouse add a user
+// event as well, since the screens always draw after any other event and a
+// frame is needed to keep the script going.
+void HeadlessRun::queueStep(unsigned step) {
+    const int mapWidth = std::max(1, mScreen->w - 300);
+    const int mapHeight = std::max(1, mScreen->h - 70);
+    const unsigned phase = (step / SCRIPT_PHASE_FRAMES) % 4;
+    const unsigned k = step % SCRIPT_PHASE_FRAMES;
+    bool needTick = false;
+
+    switch (phase) {
+        case 0: // hover across the map
+            pushMouse(mapWidth * k / SCRIPT_PHASE_FRAMES, mapHeight * k / SCRIPT_PHASE_FRAMES);
+            needTick = true;
+            break;
+        case 1: { // colour modes and zoom, ending where it started
+            const SDL_Keycode keys[] = { SDLK_s, SDLK_RIGHTBRACKET, SDLK_f, SDLK_LEFTBRACKET };
+            pushKey(keys[k % 4]);
+            break; }
+        case 2: // scroll each of the side lists
+            if (k % 20 == 0) {
+                const SDL_Keycode keys[] = { SDLK_1, SDLK_2, SDLK_3 };
+                pushKey(keys[k / 20 % 3]);
+            } else {
+                SDL_Event event = { };
+                pushMouse(mScreen->w - 150, mScreen->h / 3);
+                event.type = SDL_MOUSEWHEEL;
+                event.wheel.y = -3;
+                SDL_PushEvent(&event);
+            }
+            break;
+        case 3: // page through the realm list screen
+            if (k == 0)                             pushKey(SDLK_6);
+            else if (k == SCRIPT_PHASE_FRAMES - 1)  pushKey(SDLK_ESCAPE);
+            else                                    pushKey(SDLK_PAGEDOWN);
+            break;
+    }
+    if (needTick) {
+        SDL_Event event = { };
+        event.type = SDL_USEREVENT;
+        SDL_PushEvent(&event);
+    }
+}
+
+void HeadlessRun::report(std::ostream &out) const {
+    if (mTimes.empty()) {
+        out << "No frames drawn.\n";
+        return;
+    }
+    out << std::fixed << std::setprecision(2);
+    out << "Drew " << mTimes.size() << " frames at " << mScreen->w << 'x' << mScreen->h << ".\n";
+    out << "First frame " << mTimes[0] << " ms, including load.\n";
+    if (mTimes.size() < 2) return;
+
+    // the first frame is left out of the figures below
+    std::vector<double> sorted(mTimes.begin() + 1, mTimes.end());
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double t : sorted) total += t;
+    out << "min " << sorted.front() << "  median " << sorted[sorted.size() / 2];
+    out << "  p95 " << sorted[sorted.size() * 95 / 100] << "  max " << sorted.back();
+    out << "  mean " << total / sorted.size() << " ms\n";
+
+    const double limits[] = { 0.5, 1, 2, 4, 8, 16, 33, 66 };
+    const unsigned bucketCount = sizeof(limits) / sizeof(limits[0]) + 1;
+    unsigned counts[bucketCount] = { };
+    for (double t : sorted) {
+        unsigned b = 0;
+        while (b < bucketCount - 1 && t >= limits[b]) ++b;
+        ++counts[b];
+    }
+    const unsigned most = *std::max_element(counts, counts + bucketCount);
+    for (unsigned b = 0; b < bucketCount; ++b) {
+        std::stringstream label;
+        if (b == 0)                     label << "< " << limits[0];
+        else if (b == bucketCount - 1)  label << ">= " << limits[b - 1];
+        else                            label << limits[b - 1] << " - " << limits[b];
+        out << std::right << std::setw(10) << label.str() << " ms " << std::setw(7) << counts[b] << "  ";
+        out << std::string(counts[b] * 50 / most, '#') << '\n';
+    }
+}
+
+// Sets up a software renderer drawing into a plain surface, so no video
+// driver or display is needed, and runs the main screen under the script.
+int runHeadless(unsigned frames, int width, int height, const std::string &dumpDir) {
+    if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER) != 0) {
+        std::cerr << "SDL_Init Error: " << SDL_GetError() << '\n';
+        return 1;
+    }
+    SDL_Surface *screen = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGB888);
+    if (!screen) {
+        std::cerr << "SDL_CreateRGBSurfaceWithFormat Error: " << SDL_GetError() << '\n';
+        SDL_Quit();
+        return 1;
+    }
+    SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(screen);
+    if (!renderer) {
+        std::cerr << "SDL_CreateSoftwareRenderer Error: " << SDL_GetError() << '\n';
+        SDL_FreeSurface(screen);
+        SDL_Quit();
+        return 1;
+    }
+
+    HeadlessRun run(screen, frames, dumpDir);
+    RenderInfo rInfo;
+    rInfo.window = nullptr;
+    rInfo.renderer = renderer;
+    rInfo.fontWidth = 9;
+    rInfo.fontHeight = 18;
+    rInfo.font = rInfo.loadTexture("gfx/font.bmp");
+    rInfo.headless = &run;
+
+    innerMain(rInfo);
+    run.report(std::cout);
+
+    SDL_DestroyTexture(rInfo.font);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(screen);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+#include <SDL.h>
+
+#include "../src/realms.h"
+#include "viewer.h"
+
+// below this many pixels per map unit realms are drawn as density tiles
+const double DENSITY_SCALE = 2.0;
+// density tiles are the smallest cells at least this many pixels across
+const int DENSITY_CELL_PIXELS = 4;
+// the finest density grid has at most this many cells
+const int MAX_DENSITY_CELLS = 1 << 18;
+// links shorter than this on screen are left out of density views
+const int LONG_LINK_PIXELS = 24;
+// tiles smaller than this are drawn without outlines
+const int OUTLINE_PIXELS = 4;
+// realm names are only drawn under tiles at least this many pixels across
+const int LABEL_PIXELS = 16;
+
+// indexed by Biome
+const UIColour BIOME_COLOURS[] = {
+    UIColour(34, 139, 34),      // Forest
+    UIColour(237, 201, 175),    // Desert
+    UIColour(220, 230, 240),    // Tundra
+    UIColour(124, 200, 80),     // Grasslands
+    UIColour(200, 180, 90),     // Savanna
+    UIColour(0, 100, 40),       // Jungle
+    UIColour(40, 90, 200),      // Aquatic
+    UIColour(90, 100, 60),      // Swamp
+};
+
+void OccupancyGrid::build(World &world) {
+    mCells.clear();
+    mCells.reserve(world.realms.size());
+    for (Realm *realm : world.realms) mCells.insert(std::make_pair(key(realm->x, realm->y), realm));
+}
+
+Realm* OccupancyGrid::at(int x, int y) const {
+    auto cell = mCells.find(key(x, y));
+    return cell == mCells.end() ? nullptr : cell->second;
+}
+
+void OccupancyGrid::move(Realm *realm, int x, int y) {
+    auto from = mCells.find(key(realm->x, realm->y));
+    if (from != mCells.end() && from->second == realm) mCells.erase(from);
+    realm->x = x;
+    realm->y = y;
+    mCells[key(x, y)] = realm;
+}
+
+void MapCamera::zoomAbout(int screenX, int screenY, double factor) {
+    double fixedX = mapX(screenX);
+    double fixedY = mapY(screenY);
+    scale *= factor;
+    x = screenX - fixedX * scale;
+    y = screenY - fixedY * scale;
+}
+
+
+MapLayer::MapLayer()
+: mTexture(nullptr), mX(0), mY(0), mWidth(0), mHeight(0), mMode(Mode::Faction), mDirty(true),
+  mWorld(nullptr), mRevision(0), mIndexMode(Mode::Faction), mLongestLink(0)
+{ }
+
+MapLayer::~MapLayer() {
+    if (mTexture) SDL_DestroyTexture(mTexture);
+}
+
+void MapLayer::setArea(int x, int y, int width, int height) {
+    if (width != mWidth || height != mHeight) {
+        if (mTexture) SDL_DestroyTexture(mTexture);
+        mTexture = nullptr;
+    }
+    mX = x;
+    mY = y;
+    mWidth = width;
+    mHeight = height;
+    mDirty = true;
+}
+
+void MapLayer::setCamera(const MapCamera &camera) {
+    if (camera == mCamera) return;
+    mCamera = camera;
+    mDirty = true;
+}
+
+void MapLayer::setMode(Mode mode) {
+    if (mode == mMode) return;
+    mMode = mode;
+    mDirty = true;
+}
+
+// Brings the indexes up to date with the world and colour mode, returning
+// whether anything was rebuilt.
+bool MapLayer::updateIndexes(World &world) {
+    if (mWorld != &world || mRevision != world.revision) {
+        buildLinks(world);
+        buildDensity(world);
+        return true;
+    }
+    if (mIndexMode != mMode) {
+        buildDensity(world);
+        return true;
+    }
+    return false;
+}
+
+void MapLayer::draw(RenderInfo &r, World &world) {
+    if (updateIndexes(world)) mDirty = true;
+
+    if (!mTexture && SDL_RenderTargetSupported(r.renderer) && mWidth > 0 && mHeight > 0) {
+        mTexture = SDL_CreateTexture(r.renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                     mWidth, mHeight);
+        if (!mTexture) {
+            std::cerr << "SDL_CreateTexture Error: " << SDL_GetError() << '\n';
+        }
+        mDirty = true;
+    }
+
+    // without a texture to keep, draw straight to the screen every time
+    if (!mTexture) {
+        drawUncached(r, world);
+        return;
+    }
+
+    if (mDirty) {
+        SDL_SetRenderTarget(r.renderer, mTexture);
+        r.clear();
+        drawContents(r, world, -mX, -mY);
+        SDL_SetRenderTarget(r.renderer, nullptr);
+        mDirty = false;
+    }
+    SDL_Rect dest = { mX, mY, mWidth, mHeight };
+    SDL_RenderCopy(r.renderer, mTexture, nullptr, &dest);
+}
+
+void MapLayer::drawUncached(RenderInfo &r, World &world) {
+    updateIndexes(world);
+    SDL_Rect clip = { mX, mY, mWidth, mHeight };
+    SDL_RenderSetClipRect(r.renderer, &clip);
+    drawContents(r, world, 0, 0);
+    SDL_RenderSetClipRect(r.renderer, nullptr);
+}
+
+// Names go under their tiles. Realms just off the top or left are included
+// too, since their names can reach into the area.
+void MapLayer::drawLabels(RenderInfo &r, World &world) {
+    if (!r.font || mCamera.scale < LABEL_PIXELS) return;
+    const int reachX = std::ceil(MAX_NAME_LENGTH * r.fontWidth / mCamera.scale);
+    const int reachY = std::ceil((r.fontHeight + 2) / mCamera.scale);
+    world.positions.inside(std::floor(mCamera.mapX(mX)) - reachX, std::floor(mCamera.mapY(mY)) - reachY - 1,
+                           std::ceil(mCamera.mapX(mX + mWidth)), std::ceil(mCamera.mapY(mY + mHeight)), mVisible);
+    SDL_Rect clip = { mX, mY, mWidth, mHeight };
+    SDL_RenderSetClipRect(r.renderer, &clip);
+    for (unsigned i : mVisible) {
+        const Realm *realm = world.realms[i];
+        r.drawText(mCamera.screenX(realm->x), mCamera.screenY(realm->y + 1) + 2, realm->name);
+    }
+    SDL_RenderSetClipRect(r.renderer, nullptr);
+}
+
+int MapLayer::colourKey(const Realm *realm) const {
+    switch (mMode) {
+        case Mode::Faction: return realm->faction;
+        case Mode::Species: return realm->primarySpecies;
+        case Mode::Biome:   return static_cast<int>(realm->biome);
+        default:            return -1;
+    }
+}
+
+void MapLayer::drawOutline(RenderInfo &r, const Realm *realm, const UIColour &colour) {
+    int rx = mCamera.screenX(realm->x);
+    int ry = mCamera.screenY(realm->y);
+    int size = std::max(1, mCamera.screenX(realm->x + 1) - rx);
+    if (rx + size < mX || ry + size < mY || rx > mX + mWidth || ry > mY + mHeight) return;
+    r.batch.drawRect(rx-1, ry-1, size+2, size+2, colour);
+    r.batch.drawRect(rx, ry, size, size, colour);
+}
+
+// Colour lookup and density grids for the current colour mode.
+void MapLayer::buildDensity(World &world) {
+    mIndexMode = mMode;
+    mColours.clear();
+    if (mMode == Mode::Faction) {
+        for (const Faction *f : world.factions) mColours.insert(std::make_pair(f->ident, UIColour(f->r, f->g, f->b)));
+    } else if (mMode == Mode::Species) {
+        for (const Species *s : world.species) mColours.insert(std::make_pair(s->ident, UIColour(s->r, s->g, s->b)));
+    } else if (mMode == Mode::Biome) {
+        for (int b = 0; b < static_cast<int>(Biome::BiomeCount); ++b) mColours.insert(std::make_pair(b, BIOME_COLOURS[b]));
+    }
+
+    mDensity.clear();
+    DensityLevel level;
+    level.cellSize = 1;
+    while (static_cast<long long>(world.maxX / level.cellSize + 1) * (world.maxY / level.cellSize + 1) > MAX_DENSITY_CELLS) {
+        level.cellSize *= 2;
+    }
+    level.columns = world.maxX / level.cellSize + 1;
+    level.rows = world.maxY / level.cellSize + 1;
+    level.cells.assign(level.columns * level.rows, DensityCell{0, 0, 0, 0});
+    for (const Realm *realm : world.realms) {
+        if (realm->x < 0 || realm->y < 0 || realm->x / level.cellSize >= level.columns
+                || realm->y / level.cellSize >= level.rows) {
+            continue;
+        }
+        DensityCell &cell = level.cells[(realm->y / level.cellSize) * level.columns + realm->x / level.cellSize];
+        int key = colourKey(realm);
+        auto colour = mColours.find(key);
+        const UIColour &c = colour == mColours.end() ? INVALID : colour->second;
+        ++cell.count;
+        cell.r += c.r;
+        cell.g += c.g;
+        cell.b += c.b;
+    }
+    mDensity.push_back(level);
+    while (mDensity.back().columns > 1 || mDensity.back().rows > 1) {
+        const DensityLevel &finer = mDensity.back();
+        DensityLevel coarser;
+        coarser.cellSize = finer.cellSize * 2;
+        coarser.columns = (finer.columns + 1) / 2;
+        coarser.rows = (finer.rows + 1) / 2;
+        coarser.cells.assign(coarser.columns * coarser.rows, DensityCell{0, 0, 0, 0});
+        for (int y = 0; y < finer.rows; ++y) {
+            for (int x = 0; x < finer.columns; ++x) {
+                const DensityCell &from = finer.cells[y * finer.columns + x];
+                DensityCell &to = coarser.cells[(y / 2) * coarser.columns + x / 2];
+                to.count += from.count;
+                to.r += from.r;
+                to.g += from.g;
+                to.b += from.b;
+            }
+        }
+        mDensity.push_back(coarser);
+    }
+    for (DensityLevel &l : mDensity) {
+        l.peak = 1;
+        for (const DensityCell &cell : l.cells) l.peak = std::max(l.peak, cell.count);
+    }
+
+}
+
+// Links sorted by length and the realm marks used for culling, which only
+// change with the world.
+void MapLayer::buildLinks(World &world) {
+    mWorld = &world;
+    mRevision = world.revision;
+    mLongLinks.clear();
+    mLongestLink = 0;
+    const RealmGraph &graph = world.graph;
+    for (unsigned i = 0; i < world.realms.size() && i < graph.size(); ++i) {
+        const Realm *realm = world.realms[i];
+        for (unsigned l = graph.firstLink[i]; l < graph.firstLink[i + 1]; ++l) {
+            const Realm *target = world.realms[graph.linkTarget[l]];
+            if (target->ident <= realm->ident) continue;
+            double length = distance(realm->x, realm->y, target->x, target->y);
+            mLongLinks.push_back(MapLink{i, graph.linkTarget[l], length});
+            mLongestLink = std::max(mLongestLink, static_cast<int>(std::ceil(length)));
+        }
+    }
+    std::sort(mLongLinks.begin(), mLongLinks.end(), [](const MapLink &l, const MapLink &r) {
+        return l.length > r.length;
+    });
+    mMarked.assign(world.realms.size(), 0);
+}
+
+void MapLayer::drawContents(RenderInfo &r, World &world, int offsetX, int offsetY) {
+    if (mCamera.scale < DENSITY_SCALE && !mDensity.empty()) {
+        drawDensity(r, world, offsetX, offsetY);
+    } else {
+        drawRealms(r, world, offsetX, offsetY);
+    }
+}
+
+void MapLayer::drawRealms(RenderInfo &r, World &world, int offsetX, int offsetY) {
+    const RealmGraph &graph = world.graph;
+    const int left = std::floor(mCamera.mapX(mX)) - 1;
+    const int top = std::floor(mCamera.mapY(mY)) - 1;
+    const int right = std::ceil(mCamera.mapX(mX + mWidth));
+    const int bottom = std::ceil(mCamera.mapY(mY + mHeight));
+
+    // a link crossing the view has both ends within its length of it
+    world.positions.inside(left - mLongestLink, top - mLongestLink,
+                           right + mLongestLink, bottom + mLongestLink, mVisible);
+    for (unsigned i : mVisible) mMarked[i] = 1;
+
+    // DRAW CONNECTIONS
+    const double half = mCamera.scale / 2;
+    for (unsigned i : mVisible) {
+        if (i >= graph.size()) continue;
+        const Realm *realm = world.realms[i];
+        int rx = mCamera.screenX(realm->x) + half + offsetX;
+        int ry = mCamera.screenY(realm->y) + half + offsetY;
+        for (unsigned l = graph.firstLink[i]; l < graph.firstLink[i + 1]; ++l) {
+            const Realm *target = world.realms[graph.linkTarget[l]];
+            // links between two listed realms are drawn from the lower ident
+            if (mMarked[graph.linkTarget[l]] && target->ident <= realm->ident) continue;
+            int tx = mCamera.screenX(target->x) + half + offsetX;
+            int ty = mCamera.screenY(target->y) + half + offsetY;
+            r.batch.drawLine(rx, ry, tx, ty, WHITE);
+        }
+    }
+
+    // DRAW MAP
+    for (unsigned i : mVisible) {
+        mMarked[i] = 0;
+        const Realm *realm = world.realms[i];
+        if (realm->x < left || realm->x > right || realm->y < top || realm->y > bottom) continue;
+        int rx = mCamera.screenX(realm->x);
+        int ry = mCamera.screenY(realm->y);
+        int size = std::max(1, mCamera.screenX(realm->x + 1) - rx);
+        rx += offsetX;
+        ry += offsetY;
+        int key = colourKey(realm);
+        auto colour = mColours.find(key);
+        const UIColour &fill = colour == mColours.end() ? INVALID : colour->second;
+        if (size >= OUTLINE_PIXELS) {
+            // a grey square with the tile inset leaves the same two pixel
+            // outline as drawing both borders
+            r.batch.fillRect(rx-1, ry-1, size+2, size+2, MIDGREY);
+            r.batch.fillRect(rx+1, ry+1, size-2, size-2, fill);
+        } else {
+            r.batch.fillRect(rx, ry, size, size, fill);
+        }
+    }
+    r.flushBatch();
+}
+
+void MapLayer::drawDensity(RenderInfo &r, World &world, int offsetX, int offsetY) {
+    const double left = mCamera.mapX(mX);
+    const double top = mCamera.mapY(mY);
+    const double right = mCamera.mapX(mX + mWidth);
+    const double bottom = mCamera.mapY(mY + mHeight);
+
+    // DRAW CONNECTIONS
+    const double half = mCamera.scale / 2;
+    for (const MapLink &link : mLongLinks) {
+        if (link.length * mCamera.scale < LONG_LINK_PIXELS) break;
+        const Realm *from = world.realms[link.from];
+        const Realm *to = world.realms[link.to];
+        if (std::max(from->x, to->x) < left || std::min(from->x, to->x) > right) continue;
+        if (std::max(from->y, to->y) < top || std::min(from->y, to->y) > bottom) continue;
+        r.batch.drawLine(mCamera.screenX(from->x) + half + offsetX, mCamera.screenY(from->y) + half + offsetY,
+                         mCamera.screenX(to->x) + half + offsetX, mCamera.screenY(to->y) + half + offsetY, WHITE);
+    }
+
+    // DRAW MAP
+    unsigned levelNo = 0;
+    while (levelNo + 1 < mDensity.size() && mDensity[levelNo].cellSize * mCamera.scale < DENSITY_CELL_PIXELS) {
+        ++levelNo;
+    }
+    const DensityLevel &level = mDensity[levelNo];
+    const int firstColumn = std::max(0, static_cast<int>(std::floor(left / level.cellSize)));
+    const int firstRow = std::max(0, static_cast<int>(std::floor(top / level.cellSize)));
+    const int lastColumn = std::min(level.columns - 1, static_cast<int>(std::floor(right / level.cellSize)));
+    const int lastRow = std::min(level.rows - 1, static_cast<int>(std::floor(bottom / level.cellSize)));
+    for (int row = firstRow; row <= lastRow; ++row) {
+        int cy = mCamera.screenY(row * level.cellSize);
+        int height = mCamera.screenY((row + 1) * level.cellSize) - cy;
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const DensityCell &cell = level.cells[row * level.columns + column];
+            if (cell.count == 0) continue;
+            // busier cells are brighter
+            double shade = 0.4 + 0.6 * cell.count / level.peak;
+            UIColour colour(cell.r * shade / cell.count, cell.g * shade / cell.count, cell.b * shade / cell.count);
+            int cx = mCamera.screenX(column * level.cellSize);
+            int width = mCamera.screenX((column + 1) * level.cellSize) - cx;
+            r.batch.fillRect(cx + offsetX, cy + offsetY, width, height, colour);
+        }
+    }
+    r.flushBatch();
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <sstream>
@@ -10,6 +11,8 @@
 static std::map<int, SDL_Texture*> maps;
 
 SDL_Texture *realmMap = nullptr;
+// realm whose map is to be loaded once the current frame is on screen
+int pendingMap = -1;
 UILabel *nameEdit = nullptr;
 UILabel *coordEdit = nullptr;
 UILabel *diameterEdit = nullptr;
@@ -31,7 +34,14 @@ SDL_Texture* getMap(RenderInfo &r, int realmId) {
 }
 
 void selectRealm(World &world, RenderInfo &r, Realm *realm) {
-    realmMap = getMap(r, realm->ident);
+    auto iter = maps.find(realm->ident);
+    if (iter == maps.end()) {
+        realmMap = nullptr;
+        pendingMap = realm->ident;
+    } else {
+        realmMap = iter->second;
+        pendingMap = -1;
+    }
     nameEdit->setText(realm->name + " [" + std::to_string(realm->ident) + "]");
     coordEdit->setText(std::to_string(realm->x) + ", " + std::to_string(realm->y));
     diameterEdit->setText(intToString(realm->diameter));
@@ -100,63 +110,73 @@ void realm_list(World &world, RenderInfo &r, Realm *startingRealm) {
 
     Realm *realm = startingRealm;
     if (startingRealm) {
-        for (unsigned i = 0; i < world.realms.size(); ++i) {
-            if (world.realms[i] == startingRealm) {
-                topRow = i - maxLines / 2;
-                break;
-            }
-        }
+        int pos = world.graph.indexOf(startingRealm->ident);
+        if (pos > static_cast<int>(maxLines / 2)) topRow = std::min<unsigned>(pos - maxLines / 2, lastRow);
     }
     if (realm) selectRealm(world, r, realm);
 
+    const int maxScroll = r.getHeight() - 10;
+    FrameScheduler frames(r.frameRate);
     while (1) {
-        r.clear();
-
-        for (unsigned i = 0; i < maxLines; ++i) {
-            unsigned index = i + topRow;
-            if (index >= world.realms.size()) continue;
-            const Realm *rlm = world.realms[index];
-            UIColour color = {255, 255, 255};
-            if (rlm == realm)   color.b = 0;
-            else                color.b = 255;
-            r.drawText(0, i * lineHeight, rlm->name + " [" + std::to_string(rlm->ident) + "]", color.r, color.g, color.b);
-        }
-        r.setColour(LIGHTGREY);
-        // r.drawLine(midLine, 0, midLine, r.getHeight());
-
-        const int maxScroll = r.getHeight() - 10;
-        r.fillRect(scrollX, 0, 20, r.getHeight());
-        double percent = topRow * 100.0 / lastRow;
-        const int scrollY = percent * maxScroll / 100;
-        r.setColour(DARKGREY);
-        r.fillRect(scrollX, scrollY, 20, 10);
-
-        if (realm) {
-            SDL_Rect mapDest = { mapX, mapY, mapSize, mapSize };
-            SDL_RenderCopy(r.renderer, realmMap, nullptr, &mapDest);
-            r.setColour(RED);
-            r.drawLine(mapX + mapSize / 2, mapY, mapX + mapSize / 2, mapY + mapSize);
-            r.drawLine(mapX, mapY + mapSize / 2, mapX + mapSize, mapY + mapSize / 2);
-            for (const Link &l : realm->links) {
-                int lx, ly;
-                double radius = 200.0 * (l.distance / 100.0);
-                const double PI = 3.14159265;
-                double bearing = (l.bearing - 90) * PI / 180.0;
-                lx = radius * cos(bearing);
-                ly = radius * sin(bearing);
-                r.setColour(PINK);
-                r.fillRect(mapX + lx + mapSize / 2 - 1, mapY + ly + mapSize / 2 - 1, 3, 3);
-                r.drawText(mapX + lx + mapSize / 2 - 1, mapY + ly + mapSize / 2 - 1, std::to_string(l.linkTo));
+        if (frames.frameDue()) {
+            r.clear();
+
+            for (unsigned i = 0; i < maxLines; ++i) {
+                unsigned index = i + topRow;
+                if (index >= world.realms.size()) continue;
+                const Realm *rlm = world.realms[index];
+                UIColour color = {255, 255, 255};
+                if (rlm == realm)   color.b = 0;
+                else                color.b = 255;
+                r.drawText(0, i * lineHeight, rlm->name + " [" + std::to_string(rlm->ident) + "]", color.r, color.g, color.b);
             }
+            r.setColour(LIGHTGREY);
+            // r.drawLine(midLine, 0, midLine, r.getHeight());
+
+            r.fillRect(scrollX, 0, 20, r.getHeight());
+            double percent = topRow * 100.0 / lastRow;
+            const int scrollY = percent * maxScroll / 100;
+            r.setColour(DARKGREY);
+            r.fillRect(scrollX, scrollY, 20, 10);
+
+            if (realm) {
+                SDL_Rect mapDest = { mapX, mapY, mapSize, mapSize };
+                if (realmMap) SDL_RenderCopy(r.renderer, realmMap, nullptr, &mapDest);
+                r.setColour(RED);
+                r.drawLine(mapX + mapSize / 2, mapY, mapX + mapSize / 2, mapY + mapSize);
+                r.drawLine(mapX, mapY + mapSize / 2, mapX + mapSize, mapY + mapSize / 2);
+                for (const Link &l : realm->links) {
+                    int lx, ly;
+                    double radius = 200.0 * (l.distance / 100.0);
+                    const double PI = 3.14159265;
+                    double bearing = (l.bearing - 90) * PI / 180.0;
+                    lx = radius * cos(bearing);
+                    ly = radius * sin(bearing);
+                    r.setColour(PINK);
+                    r.fillRect(mapX + lx + mapSize / 2 - 1, mapY + ly + mapSize / 2 - 1, 3, 3);
+                    r.drawText(mapX + lx + mapSize / 2 - 1, mapY + ly + mapSize / 2 - 1, std::to_string(l.linkTo));
+                }
+            }
+
+            root->repaint(r);
+            r.render();
+            frames.frameDrawn();
+        }
+        // the map is read after the selection is drawn, so the list keeps up
+        // even when the file is slow to load
+        if (pendingMap >= 0) {
+            realmMap = getMap(r, pendingMap);
+            pendingMap = -1;
+            frames.requestFrame();
         }
 
-        root->repaint(r);
-        r.render();
+        frames.wait();
 
 
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) return;
+            if (event.type != SDL_MOUSEMOTION) frames.requestFrame();
             if (event.type == SDL_KEYDOWN) {
                 if (event.key.keysym.sym == SDLK_HOME) topRow = 0;
                 if (event.key.keysym.sym == SDLK_END) topRow = lastRow;
@@ -26,50 +26,57 @@ void species_list(World &world, RenderInfo &r, Species *startingSpecies) {
             }
         }
     }
+    const int maxScroll = r.getHeight() - 10;
+    FrameScheduler frames(r.frameRate);
     while (1) {
-        r.clear();
-
-        for (unsigned i = 0; i < maxLines; ++i) {
-            unsigned index = i + topRow;
-            if (index >= world.species.size()) continue;
-            const Species *rlm = world.species[index];
-            UIColour color = {255, 255, 255};
-            if (rlm == species)   color.b = 0;
-            else                color.b = 255;
-            r.drawText(0, i * lineHeight, rlm->name + " [" + std::to_string(rlm->ident) + "]", color.r, color.g, color.b);
-        }
-        r.setColour(LIGHTGREY);
-
-        const int maxScroll = r.getHeight() - 10;
-        r.fillRect(scrollX, 0, 20, r.getHeight());
-        double percent = topRow * 100.0 / lastRow;
-        const int scrollY = percent * maxScroll / 100;
-        r.setColour(DARKGREY);
-        r.fillRect(scrollX, scrollY, 20, 10);
-
-        if (species) {
-            int yPos = 0;
-            r.drawText(midLine + 4, yPos, species->name + " (" + species->abbrev + ") [" + std::to_string(species->ident) + "]");
-            yPos += lineHeight * 2;
-
-            std::stringstream stanceLine;
-            stanceLine << "Stance: " << species->stance;
-            r.drawText(midLine + 4, yPos, stanceLine.str());
-            yPos += lineHeight;
-            r.drawText(midLine + 4, yPos, "Avg. Height: " + intToString(species->height) + " cm");
-            yPos += lineHeight;
-            std::stringstream wingLine;
-            wingLine << "Wings: " << 0;
-            r.drawText(midLine + 4, yPos, wingLine.str());
-            yPos += lineHeight * 2;
+        if (frames.frameDue()) {
+            r.clear();
+
+            for (unsigned i = 0; i < maxLines; ++i) {
+                unsigned index = i + topRow;
+                if (index >= world.species.size()) continue;
+                const Species *rlm = world.species[index];
+                UIColour color = {255, 255, 255};
+                if (rlm == species)   color.b = 0;
+                else                color.b = 255;
+                r.drawText(0, i * lineHeight, rlm->name + " [" + std::to_string(rlm->ident) + "]", color.r, color.g, color.b);
+            }
+            r.setColour(LIGHTGREY);
+
+            r.fillRect(scrollX, 0, 20, r.getHeight());
+            double percent = topRow * 100.0 / lastRow;
+            const int scrollY = percent * maxScroll / 100;
+            r.setColour(DARKGREY);
+            r.fillRect(scrollX, scrollY, 20, 10);
+
+            if (species) {
+                int yPos = 0;
+                r.drawText(midLine + 4, yPos, species->name + " (" + species->abbrev + ") [" + std::to_string(species->ident) + "]");
+                yPos += lineHeight * 2;
+
+                std::stringstream stanceLine;
+                stanceLine << "Stance: " << species->stance;
+                r.drawText(midLine + 4, yPos, stanceLine.str());
+                yPos += lineHeight;
+                r.drawText(midLine + 4, yPos, "Avg. Height: " + intToString(species->height) + " cm");
+                yPos += lineHeight;
+                std::stringstream wingLine;
+                wingLine << "Wings: " << 0;
+                r.drawText(midLine + 4, yPos, wingLine.str());
+                yPos += lineHeight * 2;
+            }
+
+            r.render();
+            frames.frameDrawn();
         }
 
-        r.render();
+        frames.wait();
 
 
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) return;
+            if (event.type != SDL_MOUSEMOTION) frames.requestFrame();
             if (event.type == SDL_KEYDOWN) {
                 if (event.key.keysym.sym == SDLK_HOME) topRow = 0;
                 if (event.key.keysym.sym == SDLK_END) topRow = lastRow;
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <string>
 
@@ -81,6 +83,7 @@ SDL_Texture* RenderInfo::loadTexture(const std::string filename) {
 
 void RenderInfo::render() {
     SDL_RenderPresent(renderer);
+    if (headless) headless->frameDone();
 }
 
 void RenderInfo::setColour(const UIColour &c) {
@@ -88,6 +91,135 @@ void RenderInfo::setColour(const UIColour &c) {
 }
 
 
+void RenderBatch::drawRect(int x, int y, int w, int h, const UIColour &c) {
+    if (w <= 0 || h <= 0) return;
+    fillRect(x, y, w, 1, c);
+    fillRect(x, y + h - 1, w, 1, c);
+    fillRect(x, y + 1, 1, h - 2, c);
+    fillRect(x + w - 1, y + 1, 1, h - 2, c);
+}
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+
+void RenderBatch::addQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4,
+                          const UIColour &c) {
+    const int base = vertices.size();
+    const SDL_Color colour = { static_cast<Uint8>(c.r), static_cast<Uint8>(c.g), static_cast<Uint8>(c.b),
+                               SDL_ALPHA_OPAQUE };
+    vertices.push_back(SDL_Vertex{ { x1, y1 }, colour, { 0, 0 } });
+    vertices.push_back(SDL_Vertex{ { x2, y2 }, colour, { 0, 0 } });
+    vertices.push_back(SDL_Vertex{ { x3, y3 }, colour, { 0, 0 } });
+    vertices.push_back(SDL_Vertex{ { x4, y4 }, colour, { 0, 0 } });
+    const int corners[] = { 0, 1, 2, 2, 3, 0 };
+    for (int corner : corners) indices.push_back(base + corner);
+}
+
+void RenderBatch::drawLine(int x1, int y1, int x2, int y2, const UIColour &c) {
+    // a strip one pixel wide through the pixel centres, reaching half a
+    // pixel past either end so that a point still covers its pixel
+    float dx = x2 - x1, dy = y2 - y1;
+    float length = std::sqrt(dx * dx + dy * dy);
+    float ux = 0.5f, uy = 0;
+    if (length > 0) {
+        ux = dx / length * 0.5f;
+        uy = dy / length * 0.5f;
+    }
+    float ax = x1 + 0.5f - ux, ay = y1 + 0.5f - uy;
+    float bx = x2 + 0.5f + ux, by = y2 + 0.5f + uy;
+    addQuad(ax - uy, ay + ux, bx - uy, by + ux, bx + uy, by - ux, ax + uy, ay - ux, c);
+}
+
+void RenderBatch::fillRect(int x, int y, int w, int h, const UIColour &c) {
+    if (w <= 0 || h <= 0) return;
+    addQuad(x, y, x + w, y, x + w, y + h, x, y + h, c);
+}
+
+void RenderBatch::flush(SDL_Renderer *renderer) {
+    if (!indices.empty()) {
+        SDL_RenderGeometry(renderer, nullptr, vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+    vertices.clear();
+    indices.clear();
+}
+
+#else
+
+RenderBatch::Run& RenderBatch::runFor(bool lines, const UIColour &c) {
+    if (runs.empty() || runs.back().lines != lines || !(runs.back().colour == c)) {
+        unsigned first = lines ? points.size() : rects.size();
+        runs.push_back(Run{ lines, c, first, 0 });
+    }
+    return runs.back();
+}
+
+void RenderBatch::drawLine(int x1, int y1, int x2, int y2, const UIColour &c) {
+    Run &run = runFor(true, c);
+    points.push_back(SDL_Point{ x1, y1 });
+    points.push_back(SDL_Point{ x2, y2 });
+    run.count += 2;
+}
+
+void RenderBatch::fillRect(int x, int y, int w, int h, const UIColour &c) {
+    if (w <= 0 || h <= 0) return;
+    Run &run = runFor(false, c);
+    rects.push_back(SDL_Rect{ x, y, w, h });
+    ++run.count;
+}
+
+void RenderBatch::flush(SDL_Renderer *renderer) {
+    std::vector<SDL_Point> chain;
+    for (const Run &run : runs) {
+        SDL_SetRenderDrawColor(renderer, run.colour.r, run.colour.g, run.colour.b, SDL_ALPHA_OPAQUE);
+        if (!run.lines) {
+            SDL_RenderFillRects(renderer, &rects[run.first], run.count);
+            continue;
+        }
+        // segments that carry on from where the last one ended share a call
+        chain.clear();
+        for (unsigned i = run.first; i < run.first + run.count; i += 2) {
+            const SDL_Point &from = points[i];
+            if (!chain.empty() && (chain.back().x != from.x || chain.back().y != from.y)) {
+                SDL_RenderDrawLines(renderer, chain.data(), chain.size());
+                chain.clear();
+            }
+            if (chain.empty()) chain.push_back(from);
+            chain.push_back(points[i + 1]);
+        }
+        if (!chain.empty()) SDL_RenderDrawLines(renderer, chain.data(), chain.size());
+    }
+    runs.clear();
+    rects.clear();
+    points.clear();
+}
+
+#endif
+
+
+FrameScheduler::FrameScheduler(int frameRate)
+: mFrameRate(frameRate), mLastFrame(SDL_GetTicks()), mFrameDue(true)
+{ }
+
+void FrameScheduler::frameDrawn() {
+    mFrameDue = false;
+    mLastFrame = SDL_GetTicks();
+}
+
+void FrameScheduler::wait() {
+    // the event is only peeked at; the caller's poll loop takes it
+    if (mFrameDue) return;
+    if (mFrameRate <= 0) {
+        SDL_WaitEvent(nullptr);
+        return;
+    }
+
+    const Uint32 interval = 1000 / mFrameRate;
+    Uint32 elapsed = SDL_GetTicks() - mLastFrame;
+    if (elapsed >= interval || !SDL_WaitEventTimeout(nullptr, interval - elapsed)) {
+        mFrameDue = true;
+    }
+}
+
+
 
 
 UIWidget::UIWidget()
@@ -141,24 +273,61 @@ bool UILabel::handleClick(int x, int y) {
 
 
 UIList::UIList()
-: selection(-1)
+: mModel(nullptr), mSelection(-1), mTopRow(0), lineHeight(0), mTextVersion(0)
 { }
 
+UIList::~UIList() {
+    delete mModel;
+}
+
+void UIList::setModel(ListModel *model) {
+    delete mModel;
+    mModel = model;
+    mSelection = -1;
+    mTopRow = 0;
+    mRowText.clear();
+    mTextVersion = model ? model->version() : 0;
+}
+
+unsigned UIList::visibleRows() const {
+    if (lineHeight <= 0) return 1;
+    return std::max(1, (mHeight - 4) / lineHeight);
+}
+
+unsigned UIList::lastTopRow() const {
+    unsigned rows = rowCount(), shown = visibleRows();
+    return rows > shown ? rows - shown : 0;
+}
+
+const std::string& UIList::rowText(unsigned row) {
+    if (mModel->version() != mTextVersion) {
+        mRowText.clear();
+        mTextVersion = mModel->version();
+    }
+    auto iter = mRowText.find(row);
+    if (iter != mRowText.end()) return iter->second;
+    // only rows near the view are worth keeping
+    if (mRowText.size() > visibleRows() * 4 + 64) mRowText.clear();
+    return mRowText[row] = mModel->textAt(row);
+}
+
 void UIList::draw(RenderInfo &r) {
     r.setColour(WHITE);
     r.fillRect(mX, mY, mWidth, mHeight);
     lineHeight = r.fontHeight * 1.2;
-    const unsigned maxLines = (mHeight - 4) / lineHeight;
+    const unsigned maxLines = visibleRows();
+    if (mTopRow > lastTopRow()) mTopRow = lastTopRow();
     SDL_Rect clip = { mX, mY, mWidth, mHeight };
     SDL_RenderSetClipRect(r.renderer, &clip);
 
-    for (unsigned i = 0; i < items.size() && i < maxLines + 1; ++i) {
-        if (i == selection) {
+    for (unsigned i = 0; i < maxLines + 1 && mTopRow + i < rowCount(); ++i) {
+        unsigned row = mTopRow + i;
+        if (row == mSelection) {
             r.setColour(BLACK);
             r.fillRect(mX, mY + 2 + i * lineHeight, mWidth, lineHeight);
-            r.drawText(mX + 2, mY + 2 + i * lineHeight, items[i].text, 255, 255, 255);
+            r.drawText(mX + 2, mY + 2 + i * lineHeight, rowText(row), 255, 255, 255);
         } else {
-            r.drawText(mX + 2, mY + 2 + i * lineHeight, items[i].text, 0, 0, 0);
+            r.drawText(mX + 2, mY + 2 + i * lineHeight, rowText(row), 0, 0, 0);
         }
     }
 
@@ -166,6 +335,11 @@ void UIList::draw(RenderInfo &r) {
     int scrollbarX = mX + mWidth - 16;
     r.setColour(WHITE);
     r.fillRect(scrollbarX, mY, 16, mHeight);
+    if (lastTopRow() > 0) {
+        const int track = mHeight - 32 - 10;
+        r.setColour(MIDGREY);
+        r.fillRect(scrollbarX + 2, mY + 16 + static_cast<long long>(track) * mTopRow / lastTopRow(), 13, 10);
+    }
     r.setColour(BLACK);
 
     SDL_RenderDrawLine(r.renderer, scrollbarX, mY, scrollbarX, mY + mHeight);
@@ -182,29 +356,52 @@ void UIList::draw(RenderInfo &r) {
 bool UIList::handleClick(int x, int y) {
     int ry = y - mY;
     if (x > mX + mWidth - 16) {
-        // scrollbar click
+        // scrollbar click: the arrows move a line, the track jumps
+        if (ry < 16) {
+            if (mTopRow > 0) --mTopRow;
+        } else if (ry >= mHeight - 16) {
+            if (mTopRow < lastTopRow()) ++mTopRow;
+        } else if (mHeight > 32) {
+            mTopRow = static_cast<long long>(lastTopRow()) * (ry - 16) / (mHeight - 32);
+        }
         return true;
     }
 
     // item selection
-    int item = ry / lineHeight;
-    if (item >= items.size()) {
-        selection = -1;
-    } else {
-        selection = item;
-    }
+    if (lineHeight <= 0) return true;
+    setSelection(mTopRow + ry / lineHeight);
+    return true;
+}
+
+bool UIList::handleWheel(int x, int y, int amount) {
+    int row = static_cast<int>(mTopRow) - amount * 3;
+    if (row < 0) row = 0;
+    mTopRow = std::min(static_cast<unsigned>(row), lastTopRow());
     return true;
 }
 
-ListRow BAD_ROW { "", -1 };
-ListRow& UIList::getSelection() {
-    if (selection >= items.size()) return BAD_ROW;
-    return items[selection];
+int UIList::selectedIdent() const {
+    if (mSelection >= rowCount()) return -1;
+    return mModel->identAt(mSelection);
 }
 
-void UIList::setSelection(unsigned index) {
-    if (index < items.size()) selection = index;
-    else selection = -1;
+void UIList::setSelection(unsigned row) {
+    if (row < rowCount()) mSelection = row;
+    else mSelection = -1;
+}
+
+// Selects the row showing ident and scrolls it into view.
+bool UIList::selectIdent(int ident) {
+    int row = mModel ? mModel->rowOf(ident) : -1;
+    if (row < 0) return false;
+    mSelection = row;
+    scrollTo(row);
+    return true;
+}
+
+void UIList::scrollTo(unsigned row) {
+    if (row < mTopRow) mTopRow = row;
+    else if (row >= mTopRow + visibleRows()) mTopRow = row - visibleRows() + 1;
 }
 
 
@@ -230,6 +427,13 @@ bool UIPanel::handleClick(int x, int y) {
     return true;
 }
 
+bool UIPanel::handleWheel(int x, int y, int amount) {
+    for (UIWidget *child : mChildren) {
+        if (child->contains(x, y) && child->wheel(x, y, amount)) return true;
+    }
+    return true;
+}
+
 void UIRoot::draw(RenderInfo &r) {
     if (!mShown) return;
     for (UIWidget *child : mChildren) {
@@ -246,3 +450,10 @@ bool UIRoot::handleClick(int x, int y) {
     }
     return false;
 }
+
+bool UIRoot::handleWheel(int x, int y, int amount) {
+    for (UIWidget *child : mChildren) {
+        if (child->contains(x, y) && child->wheel(x, y, amount)) return true;
+    }
+    return false;
+}